@@ -7,21 +7,25 @@
 class AXIRegDriver :  public WrapperRegDriver {
 public:
   AXIRegDriver(void *baseAddr) {
-    m_baseAddr = (AccelReg *) baseAddr;
+    m_baseAddr = (uint32_t *) baseAddr;
   }
 
   virtual ~AXIRegDriver() {}
 
+  // the AXI-Lite register interface is 32 bits wide
   virtual void writeReg(unsigned int regInd, AccelReg regValue) {
-    m_baseAddr[regInd] = regValue;
+    m_baseAddr[regInd] = (uint32_t) regValue;
   }
 
   virtual AccelReg readReg(unsigned int regInd) {
     return m_baseAddr[regInd];
   }
 
+  // each register access is a single memory-mapped load or store
+  virtual bool supportsConcurrentRegAccess() { return true; }
+
 protected:
-  AccelReg * m_baseAddr;
+  uint32_t * m_baseAddr;
 
 };
 
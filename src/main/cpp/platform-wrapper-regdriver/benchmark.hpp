@@ -0,0 +1,342 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+// command line sweeps and reporting for the test/benchmark programs, so they
+// can be scripted and their results compared across platforms and builds.
+// all programs take their parameters as options, e.g.
+//
+//   ./TestMemLatency --words 64K --omr 1:16 --reps 5 --format json --out lat.json
+//
+// list-valued options take comma separated values and ranges: "lo:hi" doubles
+// from lo up to hi, "lo:hi:step" counts up in steps. numbers take K/M/G
+// (binary) suffixes. common options, handled by Benchmark:
+//
+//   --reps N        measured repetitions per sweep point (default 3)
+//   --warmup N      unmeasured repetitions before those (default 1)
+//   --format F      csv or json (default csv)
+//   --out FILE      write the report there instead of to stdout
+//   --fclk-mhz F    accelerator clock for the cycle-based GB/s (default 100)
+//
+// each repetition returns a BenchSample, and one report row is written per
+// sweep point with the averages over the measured repetitions:
+//
+//   Benchmark bench("TestSum", args);
+//   args.finish();
+//   for(words : args.getList("words", "1K:1M"))
+//     bench.run({{"words", words}}, [&]() { ... return sample; });
+//   bench.report();
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+class BenchArgs {
+public:
+  // usage lists the program specific options, printed for --help and errors
+  BenchArgs(int argc, char ** argv, const char * usage) {
+    m_prog = (argc > 0) ? argv[0] : "benchmark";
+    m_usage = usage;
+    for(int i = 1; i < argc; i++) {
+      std::string a = argv[i];
+      if(a == "--help" || a == "-h") {
+        printUsage(std::cout);
+        exit(0);
+      }
+      if(a.compare(0, 2, "--") != 0 || a.size() == 2)
+        fail("Unexpected argument " + a);
+      size_t eq = a.find('=');
+      if(eq != std::string::npos) {
+        m_opts[a.substr(2, eq - 2)] = a.substr(eq + 1);
+      } else if(i + 1 < argc) {
+        m_opts[a.substr(2)] = argv[++i];
+      } else {
+        fail("Missing value for " + a);
+      }
+    }
+  }
+
+  bool has(const std::string & name) const {
+    return m_opts.count(name) != 0;
+  }
+
+  std::string getString(const std::string & name, const std::string & def) {
+    m_used[name] = true;
+    return has(name) ? m_opts[name] : def;
+  }
+
+  uint64_t getUInt(const std::string & name, uint64_t def) {
+    m_used[name] = true;
+    return has(name) ? parseUInt(name, m_opts[name]) : def;
+  }
+
+  double getDouble(const std::string & name, double def) {
+    m_used[name] = true;
+    if(!has(name)) return def;
+    char * end = 0;
+    double ret = strtod(m_opts[name].c_str(), &end);
+    if(m_opts[name].empty() || *end != 0)
+      fail("Invalid value for --" + name);
+    return ret;
+  }
+
+  std::vector<uint64_t> getList(const std::string & name, const std::string & def) {
+    m_used[name] = true;
+    std::string s = has(name) ? m_opts[name] : def;
+    std::vector<uint64_t> ret;
+    std::stringstream ss(s);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+      size_t c0 = item.find(':');
+      if(c0 == std::string::npos) {
+        ret.push_back(parseUInt(name, item));
+        continue;
+      }
+      size_t c1 = item.find(':', c0 + 1);
+      uint64_t lo = parseUInt(name, item.substr(0, c0));
+      uint64_t hi = parseUInt(name, item.substr(c0 + 1, c1 == std::string::npos ? std::string::npos : c1 - c0 - 1));
+      uint64_t step = (c1 == std::string::npos) ? 0 : parseUInt(name, item.substr(c1 + 1));
+      if(step == 0 && lo == 0)
+        fail("Doubling range for --" + name + " must not start at 0");
+      for(uint64_t v = lo; v <= hi; v = (step == 0) ? 2 * v : v + step) {
+        ret.push_back(v);
+        // stop before the next value would wrap around
+        if((step == 0) ? (v > hi / 2) : (step > hi - v)) break;
+      }
+    }
+    if(ret.empty())
+      fail("Empty list for --" + name);
+    return ret;
+  }
+
+  // call after all options were read: rejects the unknown ones
+  void finish() {
+    for(std::map<std::string, std::string>::iterator it = m_opts.begin(); it != m_opts.end(); ++it)
+      if(!m_used.count(it->first))
+        fail("Unknown option --" + it->first);
+  }
+
+  void fail(const std::string & msg) {
+    std::cerr << msg << std::endl;
+    printUsage(std::cerr);
+    exit(2);
+  }
+
+protected:
+  std::string m_prog;
+  std::string m_usage;
+  std::map<std::string, std::string> m_opts;
+  std::map<std::string, bool> m_used;
+
+  void printUsage(std::ostream & os) {
+    os << "Usage: " << m_prog << " [options]" << std::endl << m_usage;
+    os << "  --reps N --warmup N --format csv|json --out FILE --fclk-mhz F" << std::endl;
+  }
+
+  uint64_t parseUInt(const std::string & name, const std::string & s) {
+    char * end = 0;
+    uint64_t ret = strtoull(s.c_str(), &end, 0);
+    if(s.empty() || s[0] == '-' || end == s.c_str())
+      fail("Invalid value for --" + name);
+    if(*end == 'K' || *end == 'k') { ret <<= 10; end++; }
+    else if(*end == 'M' || *end == 'm') { ret <<= 20; end++; }
+    else if(*end == 'G' || *end == 'g') { ret <<= 30; end++; }
+    if(*end != 0)
+      fail("Invalid value for --" + name);
+    return ret;
+  }
+};
+
+// result of a single repetition
+struct BenchSample {
+  uint64_t bytes;       // moved to/from memory by the accelerator
+  uint64_t words;       // elements processed, for cycles/word
+  uint64_t cycles;      // from the accelerator's cycle counter, 0 if none
+  uint64_t waitUs;      // host time waiting for the accelerator
+  bool ok;              // result was correct
+};
+
+class Benchmark {
+public:
+  typedef std::vector<std::pair<std::string, uint64_t> > Params;
+  typedef std::function<BenchSample()> RepFxn;
+
+  Benchmark(const char * name, BenchArgs & args) {
+    m_name = name;
+    m_reps = args.getUInt("reps", 3);
+    m_warmup = args.getUInt("warmup", 1);
+    m_format = args.getString("format", "csv");
+    m_outFile = args.getString("out", "");
+    m_fclkMHz = args.getDouble("fclk-mhz", 100);
+    if(m_reps == 0)
+      args.fail("--reps must be at least 1");
+    if(m_format != "csv" && m_format != "json")
+      args.fail("--format must be csv or json");
+  }
+
+  // runs the warm-up and measured repetitions of one sweep point. the wall
+  // time covers the whole repetition, including buffer setup and copies.
+  void run(const Params & params, RepFxn rep) {
+    std::vector<BenchSample> samples;
+    std::vector<uint64_t> wallUs;
+    for(unsigned int i = 0; i < getRepsPerPoint(); i++) {
+      uint64_t start = timestampUs();
+      samples.push_back(rep());
+      wallUs.push_back(timestampUs() - start);
+    }
+    add(params, samples, wallUs);
+  }
+
+  // repetitions per sweep point, warm-up included
+  unsigned int getRepsPerPoint() const { return m_warmup + m_reps; }
+
+  // adds the row of a sweep point whose repetitions were run elsewhere, e.g.
+  // in parallel by a SweepRunner. takes getRepsPerPoint() samples and their
+  // wall times, warm-up first.
+  void add(const Params & params, const std::vector<BenchSample> & samples,
+    const std::vector<uint64_t> & wallUs) {
+    if(samples.size() != getRepsPerPoint() || wallUs.size() != samples.size())
+      throw "Wrong number of benchmark samples";
+    Row r;
+    r.params = params;
+    r.ok = true;
+    r.bytes = r.words = 0;
+    r.cycles = r.waitUs = r.wallUs = 0;
+    r.wallUsMin = 0;
+    for(unsigned int i = 0; i < samples.size(); i++) {
+      const BenchSample & s = samples[i];
+      r.ok = r.ok && s.ok;
+      if(i < m_warmup) continue;
+      r.bytes = s.bytes;
+      r.words = s.words;
+      r.cycles += s.cycles;
+      r.waitUs += s.waitUs;
+      r.wallUs += wallUs[i];
+      if(i == m_warmup || wallUs[i] < r.wallUsMin) r.wallUsMin = wallUs[i];
+    }
+    r.cycles /= m_reps;
+    r.waitUs /= m_reps;
+    r.wallUs /= m_reps;
+    m_rows.push_back(r);
+    // progress on stderr, stdout may be carrying the report
+    std::cerr << m_name;
+    for(unsigned int i = 0; i < params.size(); i++)
+      std::cerr << " " << params[i].first << "=" << params[i].second;
+    std::cerr << (r.ok ? " ok" : " FAILED") << ", " << r.cycles << " cycles, ";
+    std::cerr << r.wallUs << " us" << std::endl;
+  }
+
+  bool allOK() const {
+    for(unsigned int i = 0; i < m_rows.size(); i++)
+      if(!m_rows[i].ok) return false;
+    return true;
+  }
+
+  // writes the report to --out, or to stdout
+  void report() {
+    if(m_outFile.empty()) {
+      write(std::cout);
+      return;
+    }
+    std::ofstream out(m_outFile.c_str());
+    if(!out)
+      throw "Could not open benchmark output file";
+    write(out);
+  }
+
+  void write(std::ostream & os) {
+    if(m_format == "json") writeJSON(os);
+    else writeCSV(os);
+  }
+
+protected:
+  struct Row {
+    Params params;
+    bool ok;
+    uint64_t bytes, words;
+    double cycles, waitUs, wallUs;
+    uint64_t wallUsMin;
+  };
+
+  std::string m_name;
+  unsigned int m_reps;
+  unsigned int m_warmup;
+  std::string m_format;
+  std::string m_outFile;
+  double m_fclkMHz;
+  std::vector<Row> m_rows;
+
+  static uint64_t timestampUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static const unsigned int numMetrics = 10;
+
+  static const char * metricName(unsigned int i) {
+    static const char * names[numMetrics] = {
+      "reps", "ok", "bytes", "cycles", "cycles_per_word", "accel_gbps",
+      "wait_us", "host_gbps", "wall_us", "wall_us_min"
+    };
+    return names[i];
+  }
+
+  // GB/s from the cycle count at --fclk-mhz, and from the host wait time.
+  // the latter is meaningless on the emulators.
+  double metric(const Row & r, unsigned int i) {
+    switch(i) {
+      case 0: return m_reps;
+      case 1: return r.ok;
+      case 2: return r.bytes;
+      case 3: return r.cycles;
+      case 4: return r.words ? r.cycles / r.words : 0;
+      case 5: return r.cycles ? r.bytes * m_fclkMHz / r.cycles / 1000 : 0;
+      case 6: return r.waitUs;
+      case 7: return r.waitUs ? r.bytes / r.waitUs / 1000 : 0;
+      case 8: return r.wallUs;
+      default: return r.wallUsMin;
+    }
+  }
+
+  void writeCSV(std::ostream & os) {
+    if(m_rows.empty()) return;
+    os << "benchmark";
+    for(unsigned int i = 0; i < m_rows[0].params.size(); i++)
+      os << "," << m_rows[0].params[i].first;
+    for(unsigned int i = 0; i < numMetrics; i++)
+      os << "," << metricName(i);
+    os << std::endl;
+    for(unsigned int r = 0; r < m_rows.size(); r++) {
+      os << m_name;
+      for(unsigned int i = 0; i < m_rows[r].params.size(); i++)
+        os << "," << m_rows[r].params[i].second;
+      for(unsigned int i = 0; i < numMetrics; i++)
+        os << "," << metric(m_rows[r], i);
+      os << std::endl;
+    }
+  }
+
+  void writeJSON(std::ostream & os) {
+    os << "{\"benchmark\": \"" << m_name << "\", \"fclk_mhz\": " << m_fclkMHz;
+    os << ", \"results\": [";
+    for(unsigned int r = 0; r < m_rows.size(); r++) {
+      os << (r ? ",\n  {" : "\n  {");
+      for(unsigned int i = 0; i < m_rows[r].params.size(); i++)
+        os << "\"" << m_rows[r].params[i].first << "\": " << m_rows[r].params[i].second << ", ";
+      for(unsigned int i = 0; i < numMetrics; i++)
+        os << (i ? ", " : "") << "\"" << metricName(i) << "\": " << metric(m_rows[r], i);
+      os << "}";
+    }
+    os << "\n]}" << std::endl;
+  }
+};
+
+#endif // BENCHMARK_HPP
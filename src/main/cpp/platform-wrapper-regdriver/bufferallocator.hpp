@@ -0,0 +1,376 @@
+#ifndef BUFFERALLOCATOR_HPP
+#define BUFFERALLOCATOR_HPP
+
+// TLSF-style (two-level segregated fit) allocator for accelerator memory
+// windows, shared by drivers that manage a fixed range of accelerator memory
+// themselves (LinuxPhysRegDriver and the emulator drivers)
+// - all block sizes and addresses are multiples of the alignment (64 bytes)
+// - free blocks are kept in size-class lists indexed by two bitmaps, so both
+//   alloc and dealloc are O(1); freed blocks are immediately coalesced with
+//   their free neighbours
+// - block descriptors live in host memory, the managed range itself is never
+//   touched (it might not even be host-accessible, e.g. in emulation)
+
+#include <stdint.h>
+#include <iostream>
+#include <unordered_map>
+
+class BufferAllocator {
+public:
+  BufferAllocator(uint64_t base, uint64_t numBytes, uint64_t alignment = 64) {
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0)
+      throw "BufferAllocator alignment must be a power of two";
+    m_align = alignment;
+    // only manage the aligned part of the given range
+    m_base = roundUp(base);
+    m_size = (base + numBytes > m_base) ? (base + numBytes - m_base) : 0;
+    m_size -= m_size % m_align;
+    m_flBitmap = 0;
+    for(unsigned int i = 0; i < FL_COUNT; i++) {
+      m_slBitmap[i] = 0;
+      for(unsigned int j = 0; j < SL_COUNT; j++)
+        m_freeLists[i][j] = 0;
+    }
+    m_physHead = 0;
+    resetStats();
+    if(m_size > 0) {
+      m_physHead = newBlock(m_base, m_size, 0);
+      insertFree(m_physHead);
+    }
+  }
+
+  ~BufferAllocator() {
+    Block * b = m_physHead;
+    while(b) {
+      Block * n = b->nextPhys;
+      delete b;
+      b = n;
+    }
+  }
+
+  // returns the address of a new block of at least numBytes bytes
+  uint64_t alloc(uint64_t numBytes) {
+    uint64_t size = roundUp(numBytes == 0 ? 1 : numBytes);
+    if(size < numBytes)
+      throw "BufferAllocator request too large";
+    Block * b = findFree(size);
+    if(!b)
+      throw "BufferAllocator out of memory";
+    removeFree(b);
+    // return the tail of the block to the free lists, if any
+    if(b->size > size) {
+      Block * rest = newBlock(b->addr + size, b->size - size, b);
+      rest->nextPhys = b->nextPhys;
+      if(b->nextPhys) b->nextPhys->prevPhys = rest;
+      b->nextPhys = rest;
+      b->size = size;
+      insertFree(rest);
+    }
+    b->free = false;
+    b->requested = numBytes;
+    m_used[b->addr] = b;
+    // update statistics
+    m_allocCount++;
+    m_bytesInUse += b->size;
+    m_bytesRequested += numBytes;
+    if(m_bytesInUse > m_highWaterMark) m_highWaterMark = m_bytesInUse;
+    uint64_t top = b->addr + b->size - m_base;
+    if(top > m_highestAddr) m_highestAddr = top;
+    return b->addr;
+  }
+
+  void dealloc(uint64_t addr) {
+    std::unordered_map<uint64_t, Block *>::iterator it = m_used.find(addr);
+    if(it == m_used.end())
+      throw "BufferAllocator dealloc of unknown buffer";
+    Block * b = it->second;
+    m_used.erase(it);
+    m_deallocCount++;
+    m_bytesInUse -= b->size;
+    m_bytesRequested -= b->requested;
+    b->requested = 0;
+    b->free = true;
+    // coalesce with free physical neighbours
+    Block * n = b->nextPhys;
+    if(n && n->free) {
+      removeFree(n);
+      mergeWithNext(b);
+    }
+    Block * p = b->prevPhys;
+    if(p && p->free) {
+      removeFree(p);
+      mergeWithNext(p);
+      b = p;
+    }
+    insertFree(b);
+  }
+
+  // returns true if addr is the start of a live allocation
+  bool isAllocated(uint64_t addr) const {
+    return m_used.find(addr) != m_used.end();
+  }
+
+  // size of the block backing a live allocation (alignment-rounded)
+  uint64_t allocSize(uint64_t addr) const {
+    std::unordered_map<uint64_t, Block *>::const_iterator it = m_used.find(addr);
+    if(it == m_used.end())
+      throw "BufferAllocator allocSize of unknown buffer";
+    return it->second->size;
+  }
+
+  // statistics
+  uint64_t base() const { return m_base; }
+  uint64_t size() const { return m_size; }
+  uint64_t bytesInUse() const { return m_bytesInUse; }
+  uint64_t bytesFree() const { return m_size - m_bytesInUse; }
+  uint64_t highWaterMark() const { return m_highWaterMark; }
+  // highest offset from base ever handed out, i.e. the memory footprint
+  uint64_t highestAddrUsed() const { return m_highestAddr; }
+  uint64_t liveAllocations() const { return m_used.size(); }
+  uint64_t allocCount() const { return m_allocCount; }
+  uint64_t deallocCount() const { return m_deallocCount; }
+
+  uint64_t largestFreeBlock() const {
+    // the largest block lives in the highest non-empty size class, but blocks
+    // in one class can differ in size, so scan that single list
+    if(!m_flBitmap) return 0;
+    unsigned int fl = fls64(m_flBitmap);
+    unsigned int sl = fls64(m_slBitmap[fl]);
+    uint64_t ret = 0;
+    for(Block * b = m_freeLists[fl][sl]; b; b = b->nextFree)
+      if(b->size > ret) ret = b->size;
+    return ret;
+  }
+
+  // external fragmentation: 0 when all free memory is one contiguous block,
+  // approaching 1 as the free memory gets split into many small pieces
+  double fragmentation() const {
+    uint64_t freeBytes = bytesFree();
+    if(freeBytes == 0) return 0.0;
+    return 1.0 - (double) largestFreeBlock() / (double) freeBytes;
+  }
+
+  // internal fragmentation: bytes lost to alignment rounding
+  uint64_t paddingBytes() const { return m_bytesInUse - m_bytesRequested; }
+
+  void resetStats() {
+    m_allocCount = m_deallocCount = 0;
+    m_bytesInUse = m_bytesRequested = 0;
+    m_highWaterMark = m_highestAddr = 0;
+    for(std::unordered_map<uint64_t, Block *>::iterator it = m_used.begin(); it != m_used.end(); ++it) {
+      m_bytesInUse += it->second->size;
+      m_bytesRequested += it->second->requested;
+    }
+    m_highWaterMark = m_bytesInUse;
+  }
+
+  // binary save/restore of the live allocations, e.g. for emulator
+  // checkpoints. restoring frees all current allocations and rebuilds the
+  // saved layout, statistics restart from the restored state.
+  void saveLayout(std::ostream & os) const {
+    uint64_t hdr[3] = {m_base, m_size, m_used.size()};
+    os.write((const char *) hdr, sizeof(hdr));
+    for(Block * b = m_physHead; b; b = b->nextPhys) {
+      if(b->free) continue;
+      uint64_t rec[3] = {b->addr, b->size, b->requested};
+      os.write((const char *) rec, sizeof(rec));
+    }
+  }
+
+  void restoreLayout(std::istream & is) {
+    uint64_t hdr[3];
+    is.read((char *) hdr, sizeof(hdr));
+    if(!is || hdr[0] != m_base || hdr[1] != m_size)
+      throw "BufferAllocator layout does not match this allocator";
+    // back to a single free block
+    while(!m_used.empty())
+      dealloc(m_used.begin()->first);
+    for(uint64_t i = 0; i < hdr[2]; i++) {
+      uint64_t rec[3];
+      is.read((char *) rec, sizeof(rec));
+      if(!is)
+        throw "BufferAllocator layout truncated";
+      allocAt(rec[0], rec[1], rec[2]);
+    }
+    resetStats();
+  }
+
+  void printStats(std::ostream & os) const {
+    os << "Accel buffer allocator: " << m_size << " bytes at 0x" << std::hex << m_base << std::dec << std::endl;
+    os << "  in use: " << m_bytesInUse << " bytes in " << m_used.size() << " buffers";
+    os << " (" << paddingBytes() << " bytes alignment padding)" << std::endl;
+    os << "  high-water mark: " << m_highWaterMark << " bytes, footprint: " << m_highestAddr << " bytes" << std::endl;
+    os << "  allocs: " << m_allocCount << " deallocs: " << m_deallocCount << std::endl;
+    os << "  largest free block: " << largestFreeBlock() << " bytes, fragmentation: " << fragmentation() << std::endl;
+  }
+
+protected:
+  // first level: one class per power of two, second level: SL_COUNT linear
+  // subdivisions of each power of two. sizes are counted in alignment units.
+  static const unsigned int SL_LOG2 = 4;
+  static const unsigned int SL_COUNT = 1 << SL_LOG2;
+  static const unsigned int FL_COUNT = 64 - SL_LOG2 + 1;
+
+  struct Block {
+    uint64_t addr;
+    uint64_t size;
+    uint64_t requested;
+    bool free;
+    Block * prevPhys;
+    Block * nextPhys;
+    Block * prevFree;
+    Block * nextFree;
+  };
+
+  uint64_t m_base;
+  uint64_t m_size;
+  uint64_t m_align;
+  uint64_t m_flBitmap;
+  uint32_t m_slBitmap[FL_COUNT];
+  Block * m_freeLists[FL_COUNT][SL_COUNT];
+  Block * m_physHead;
+  std::unordered_map<uint64_t, Block *> m_used;
+
+  uint64_t m_allocCount, m_deallocCount;
+  uint64_t m_bytesInUse, m_bytesRequested;
+  uint64_t m_highWaterMark, m_highestAddr;
+
+  uint64_t roundUp(uint64_t x) const { return (x + m_align - 1) & ~(m_align - 1); }
+
+  // index of the most/least significant set bit, x must be nonzero
+  static unsigned int fls64(uint64_t x) { return 63 - __builtin_clzll(x); }
+  static unsigned int ffs64(uint64_t x) { return __builtin_ctzll(x); }
+
+  Block * newBlock(uint64_t addr, uint64_t size, Block * prevPhys) {
+    Block * b = new Block;
+    b->addr = addr;
+    b->size = size;
+    b->requested = 0;
+    b->free = true;
+    b->prevPhys = prevPhys;
+    b->nextPhys = 0;
+    b->prevFree = b->nextFree = 0;
+    return b;
+  }
+
+  // size class containing a block of the given size
+  void mapping(uint64_t size, unsigned int & fl, unsigned int & sl) const {
+    uint64_t units = size / m_align;
+    if(units < SL_COUNT) {
+      fl = 0;
+      sl = (unsigned int) units;
+    } else {
+      unsigned int msb = fls64(units);
+      fl = msb - SL_LOG2 + 1;
+      sl = (unsigned int) (units >> (msb - SL_LOG2)) - SL_COUNT;
+    }
+  }
+
+  // smallest size class where every block is large enough for size
+  bool mappingSearch(uint64_t size, unsigned int & fl, unsigned int & sl) const {
+    uint64_t units = size / m_align;
+    if(units >= SL_COUNT) {
+      uint64_t roundBits = ((uint64_t) 1 << (fls64(units) - SL_LOG2)) - 1;
+      if(units + roundBits < units) return false;
+      units += roundBits;
+    }
+    mapping(units * m_align, fl, sl);
+    return fl < FL_COUNT;
+  }
+
+  Block * findFree(uint64_t size) {
+    unsigned int fl, sl;
+    if(!mappingSearch(size, fl, sl)) return 0;
+    uint32_t slMap = m_slBitmap[fl] & (~0U << sl);
+    if(!slMap) {
+      uint64_t flMap = (fl + 1 < 64) ? (m_flBitmap & (~(uint64_t) 0 << (fl + 1))) : 0;
+      if(!flMap) {
+        // no class guarantees a fit, but a block in the request's own class
+        // may still be large enough (e.g. a single free block spanning
+        // the whole window)
+        unsigned int efl, esl;
+        mapping(size, efl, esl);
+        for(Block * b = m_freeLists[efl][esl]; b; b = b->nextFree)
+          if(b->size >= size) return b;
+        return 0;
+      }
+      fl = ffs64(flMap);
+      slMap = m_slBitmap[fl];
+    }
+    sl = ffs64(slMap);
+    return m_freeLists[fl][sl];
+  }
+
+  void insertFree(Block * b) {
+    unsigned int fl, sl;
+    mapping(b->size, fl, sl);
+    b->free = true;
+    b->prevFree = 0;
+    b->nextFree = m_freeLists[fl][sl];
+    if(b->nextFree) b->nextFree->prevFree = b;
+    m_freeLists[fl][sl] = b;
+    m_flBitmap |= (uint64_t) 1 << fl;
+    m_slBitmap[fl] |= 1U << sl;
+  }
+
+  void removeFree(Block * b) {
+    unsigned int fl, sl;
+    mapping(b->size, fl, sl);
+    if(b->prevFree) b->prevFree->nextFree = b->nextFree;
+    else m_freeLists[fl][sl] = b->nextFree;
+    if(b->nextFree) b->nextFree->prevFree = b->prevFree;
+    b->prevFree = b->nextFree = 0;
+    if(!m_freeLists[fl][sl]) {
+      m_slBitmap[fl] &= ~(1U << sl);
+      if(!m_slBitmap[fl]) m_flBitmap &= ~((uint64_t) 1 << fl);
+    }
+  }
+
+  // carve the block [addr, addr+size) out of the free block containing it
+  void allocAt(uint64_t addr, uint64_t size, uint64_t requested) {
+    Block * b = m_physHead;
+    while(b && !(b->addr <= addr && addr < b->addr + b->size)) b = b->nextPhys;
+    if(!b || !b->free || addr + size > b->addr + b->size || size == 0)
+      throw "BufferAllocator layout overlaps or is out of range";
+    removeFree(b);
+    if(b->addr < addr) {
+      // keep the head free, continue with the rest
+      Block * rest = newBlock(addr, b->addr + b->size - addr, b);
+      rest->nextPhys = b->nextPhys;
+      if(b->nextPhys) b->nextPhys->prevPhys = rest;
+      b->nextPhys = rest;
+      b->size = addr - b->addr;
+      insertFree(b);
+      b = rest;
+    }
+    if(b->size > size) {
+      Block * rest = newBlock(b->addr + size, b->size - size, b);
+      rest->nextPhys = b->nextPhys;
+      if(b->nextPhys) b->nextPhys->prevPhys = rest;
+      b->nextPhys = rest;
+      b->size = size;
+      insertFree(rest);
+    }
+    b->free = false;
+    b->requested = requested;
+    m_used[b->addr] = b;
+    uint64_t top = b->addr + b->size - m_base;
+    if(top > m_highestAddr) m_highestAddr = top;
+  }
+
+  // absorb b's (free, unlisted) physical successor into b
+  void mergeWithNext(Block * b) {
+    Block * n = b->nextPhys;
+    b->size += n->size;
+    b->nextPhys = n->nextPhys;
+    if(n->nextPhys) n->nextPhys->prevPhys = b;
+    delete n;
+  }
+
+private:
+  // block descriptors are owned by the allocator, no copies
+  BufferAllocator(const BufferAllocator &);
+  BufferAllocator & operator=(const BufferAllocator &);
+};
+
+#endif // BUFFERALLOCATOR_HPP
@@ -0,0 +1,105 @@
+#ifndef CHANNELSCHEDULER_HPP
+#define CHANNELSCHEDULER_HPP
+
+// small job scheduler for accelerators with independent channels (e.g.
+// TestMultiChanSum). there is one host worker thread per channel, and a job
+// is a function that drives one channel from start to completion. jobs can
+// go to a particular channel or to whichever channel frees up first, and
+// submitting returns a future for the job's completion (which rethrows
+// anything the job threw). the jobs share a driver, so use a
+// ThreadSafeRegDriver.
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class ChannelScheduler {
+public:
+  // a job is called with the index of the channel it runs on
+  typedef std::function<void(unsigned int chan)> JobFxn;
+
+  ChannelScheduler(unsigned int numChans) {
+    if(numChans == 0)
+      throw "ChannelScheduler needs at least one channel";
+    m_stop = false;
+    m_chanQueues.resize(numChans);
+    for(unsigned int i = 0; i < numChans; i++)
+      m_workers.push_back(std::thread(&ChannelScheduler::worker, this, i));
+  }
+
+  // finishes all submitted jobs before returning
+  ~ChannelScheduler() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for(unsigned int i = 0; i < m_workers.size(); i++)
+      m_workers[i].join();
+  }
+
+  // run on the first channel that becomes available
+  std::future<void> submit(JobFxn job) {
+    return enqueue(m_anyQueue, job);
+  }
+
+  // run on the given channel, after the jobs already queued for it
+  std::future<void> submit(unsigned int chan, JobFxn job) {
+    if(chan >= m_chanQueues.size())
+      throw "ChannelScheduler channel out of range";
+    return enqueue(m_chanQueues[chan], job);
+  }
+
+  unsigned int getNumChannels() { return m_chanQueues.size(); }
+
+protected:
+  typedef std::shared_ptr<std::packaged_task<void(unsigned int)> > Task;
+
+  std::vector<std::thread> m_workers;
+  std::vector<std::deque<Task> > m_chanQueues;
+  std::deque<Task> m_anyQueue;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stop;
+
+  std::future<void> enqueue(std::deque<Task> & queue, JobFxn job) {
+    Task task(new std::packaged_task<void(unsigned int)>(job));
+    std::future<void> ret = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      queue.push_back(task);
+    }
+    m_wake.notify_all();
+    return ret;
+  }
+
+  void worker(unsigned int chan) {
+    std::deque<Task> & ownQueue = m_chanQueues[chan];
+    while(true) {
+      Task task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(ownQueue.empty() && m_anyQueue.empty() && !m_stop)
+          m_wake.wait(lock);
+        // jobs for this channel take priority over unassigned ones
+        std::deque<Task> & queue = ownQueue.empty() ? m_anyQueue : ownQueue;
+        if(queue.empty()) return;   // stopping and nothing left to do
+        task = queue.front();
+        queue.pop_front();
+      }
+      (*task)(chan);
+    }
+  }
+
+private:
+  // owns worker threads, no copies
+  ChannelScheduler(const ChannelScheduler &);
+  ChannelScheduler & operator=(const ChannelScheduler &);
+};
+
+#endif // CHANNELSCHEDULER_HPP
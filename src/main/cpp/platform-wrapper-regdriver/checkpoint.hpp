@@ -0,0 +1,102 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+// common parts of the emulator checkpoint files: a fixed header, followed by
+// the buffer allocator layout and an optional blob of application data (e.g.
+// the addresses of the buffers it allocated), followed by the model state,
+// the touched main memory pages and the memory timing model state in a
+// driver-specific format. restoring reads and checks everything into
+// temporaries first, and only then replaces the driver state, so a bad
+// file leaves the driver as it was.
+
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <sys/stat.h>
+#include "bufferallocator.hpp"
+#include "sparsemem.hpp"
+
+#define CHECKPOINT_MAGIC "TIDBCKPT"
+#define CHECKPOINT_VERSION 4
+
+// which driver wrote the checkpoint
+#define CHECKPOINT_KIND_CHISEL 1
+#define CHECKPOINT_KIND_VERILATED 2
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t kind;
+  uint64_t modelBytes;    // sizeof the model class, to catch a different accelerator
+  uint64_t fingerprint;   // TESTER_MODEL_FINGERPRINT of the build that wrote it
+  uint64_t cycle;         // driver cycle counter at the time of the checkpoint
+  uint64_t userBytes;     // size of the application data
+  uint64_t imageOffset;   // file offset of the model state
+  uint64_t memPages;      // number of main memory pages saved
+  uint64_t memOffset;     // file offset of the page data, 0 if in the model stream
+  // driver state outside the model
+  uint32_t irqLevel;      // level of the irq output after the last cycle
+  uint32_t irqPending;    // interrupt eventfd had an unconsumed event
+  uint32_t hasMemModel;   // memory timing model state follows the memory pages
+  uint32_t reserved;
+};
+
+class CheckpointMeta {
+public:
+  // header, allocator layout and application data, unpadded
+  static std::string serialize(CheckpointHeader & hdr, const BufferAllocator & alloc,
+    const void * userData, uint64_t userBytes) {
+    memcpy(hdr.magic, CHECKPOINT_MAGIC, 8);
+    hdr.version = CHECKPOINT_VERSION;
+    hdr.reserved = 0;
+    hdr.userBytes = userBytes;
+    std::string layout = layoutOf(alloc);
+    std::string ret((const char *) &hdr, sizeof(hdr));
+    ret += layout;
+    ret.append((const char *) userData, userBytes);
+    return ret;
+  }
+
+  // reads and checks the header, and reads the allocator layout into layout
+  // (a fresh allocator of the same size) and the application data into
+  // user. changes nothing else, the caller commits these once the rest of
+  // the file has been read. fileBytes is the size of the whole file.
+  static void deserialize(std::istream & is, uint64_t fileBytes, CheckpointHeader & hdr, uint32_t kind,
+    uint64_t modelBytes, uint64_t fingerprint, BufferAllocator & layout, std::string & user) {
+    is.read((char *) &hdr, sizeof(hdr));
+    if(!is || memcmp(hdr.magic, CHECKPOINT_MAGIC, 8) != 0 || hdr.version != CHECKPOINT_VERSION)
+      throw "Not a checkpoint file";
+    if(hdr.kind != kind || hdr.modelBytes != modelBytes || hdr.fingerprint != fingerprint)
+      throw "Checkpoint was saved from a different emulator model";
+    if(hdr.userBytes > fileBytes || hdr.memPages > fileBytes / SparseMem::PAGE_BYTES)
+      throw "Checkpoint file truncated";
+    layout.restoreLayout(is);
+    user.assign(hdr.userBytes, '\0');
+    is.read(&user[0], hdr.userBytes);
+    if(!is)
+      throw "Checkpoint file truncated";
+  }
+
+  // copy up to userBytes of the application data read by deserialize
+  static void copyUserData(const std::string & user, void * userData, uint64_t userBytes) {
+    if(userData) memcpy(userData, user.data(), (userBytes < user.size()) ? userBytes : user.size());
+  }
+
+  static uint64_t fileSize(const char * fileName) {
+    struct stat st;
+    if(stat(fileName, &st) != 0)
+      throw "Could not open checkpoint file";
+    return st.st_size;
+  }
+
+protected:
+  static std::string layoutOf(const BufferAllocator & alloc) {
+    std::ostringstream os;
+    alloc.saveLayout(os);
+    return os.str();
+  }
+};
+
+#endif // CHECKPOINT_HPP
@@ -0,0 +1,205 @@
+#ifndef COPYENGINE_HPP
+#define COPYENGINE_HPP
+
+// bulk copy engine for host<->accelerator transfers through mapped memory
+// (e.g. the uncached /dev/mem window of LinuxPhysRegDriver). the copy
+// strategy is picked by size:
+// - small copies use plain memcpy
+// - medium copies use a 64-byte-per-iteration loop of SSE2 or NEON wide
+//   loads/stores, which keeps bursts long on uncached mappings. copies into
+//   the uncached window use non-temporal stores on SSE2, so the cache is not
+//   polluted with data we won't touch again. copies into host memory use
+//   regular stores, since the caller is about to read that data.
+// - large copies are split into 64-byte aligned parts, which are copied in
+//   parallel by a pool of worker threads (build with -pthread)
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+class CopyEngine {
+public:
+  // numThreads = 0 uses one thread per hardware thread
+  CopyEngine(unsigned int numThreads = 0) {
+    if(numThreads == 0) numThreads = std::thread::hardware_concurrency();
+    if(numThreads == 0) numThreads = 1;
+    m_numThreads = numThreads;
+    m_wideThreshold = 256;
+    m_threadThreshold = 1024 * 1024;
+    m_stop = false;
+    m_generation = 0;
+    m_pending = 0;
+    m_dst = 0;
+    m_src = 0;
+    m_numBytes = 0;
+    m_partBytes = 0;
+    m_streamStores = false;
+    // the calling thread copies part 0, the pool copies the rest
+    for(unsigned int i = 1; i < m_numThreads; i++)
+      m_workers.push_back(std::thread(&CopyEngine::worker, this, i));
+  }
+
+  ~CopyEngine() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for(unsigned int i = 0; i < m_workers.size(); i++)
+      m_workers[i].join();
+  }
+
+  // uncachedDst is true for copies into the uncached accelerator window,
+  // false for copies into ordinary host memory
+  void copy(void * dst, const void * src, uint64_t numBytes, bool uncachedDst) {
+    if(numBytes < m_wideThreshold)
+      memcpy(dst, src, numBytes);
+    else if(numBytes < m_threadThreshold || m_numThreads == 1)
+      wideCopy(dst, src, numBytes, uncachedDst);
+    else
+      parallelCopy(dst, src, numBytes, uncachedDst);
+  }
+
+  // copies at least this large use the wide copy loop
+  void setWideThreshold(uint64_t numBytes) { m_wideThreshold = numBytes; }
+  uint64_t getWideThreshold() { return m_wideThreshold; }
+  // copies at least this large are split across threads
+  void setThreadThreshold(uint64_t numBytes) { m_threadThreshold = numBytes; }
+  uint64_t getThreadThreshold() { return m_threadThreshold; }
+  unsigned int getNumThreads() { return m_numThreads; }
+
+  // single-threaded copy using the widest loads/stores available,
+  // non-temporal ones if streamStores is set
+  static void wideCopy(void * dst, const void * src, uint64_t numBytes, bool streamStores) {
+    uint8_t * d = (uint8_t *) dst;
+    const uint8_t * s = (const uint8_t *) src;
+#if defined(__SSE2__)
+    if(!streamStores) {
+      for(; numBytes >= 64; numBytes -= 64, d += 64, s += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *) s);
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (s + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (s + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i *) (s + 48));
+        _mm_storeu_si128((__m128i *) d, v0);
+        _mm_storeu_si128((__m128i *) (d + 16), v1);
+        _mm_storeu_si128((__m128i *) (d + 32), v2);
+        _mm_storeu_si128((__m128i *) (d + 48), v3);
+      }
+      memcpy(d, s, numBytes);
+      return;
+    }
+    // non-temporal stores need a 16-byte aligned destination
+    uint64_t head = (16 - ((uintptr_t) d & 15)) & 15;
+    if(head > numBytes) head = numBytes;
+    memcpy(d, s, head);
+    d += head; s += head; numBytes -= head;
+    for(; numBytes >= 64; numBytes -= 64, d += 64, s += 64) {
+      __m128i v0 = _mm_loadu_si128((const __m128i *) s);
+      __m128i v1 = _mm_loadu_si128((const __m128i *) (s + 16));
+      __m128i v2 = _mm_loadu_si128((const __m128i *) (s + 32));
+      __m128i v3 = _mm_loadu_si128((const __m128i *) (s + 48));
+      _mm_stream_si128((__m128i *) d, v0);
+      _mm_stream_si128((__m128i *) (d + 16), v1);
+      _mm_stream_si128((__m128i *) (d + 32), v2);
+      _mm_stream_si128((__m128i *) (d + 48), v3);
+    }
+    // make the streaming stores globally visible before returning
+    _mm_sfence();
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    for(; numBytes >= 64; numBytes -= 64, d += 64, s += 64) {
+      uint8x16_t v0 = vld1q_u8(s);
+      uint8x16_t v1 = vld1q_u8(s + 16);
+      uint8x16_t v2 = vld1q_u8(s + 32);
+      uint8x16_t v3 = vld1q_u8(s + 48);
+      vst1q_u8(d, v0);
+      vst1q_u8(d + 16, v1);
+      vst1q_u8(d + 32, v2);
+      vst1q_u8(d + 48, v3);
+    }
+#endif
+    memcpy(d, s, numBytes);
+  }
+
+protected:
+  unsigned int m_numThreads;
+  uint64_t m_wideThreshold;
+  uint64_t m_threadThreshold;
+
+  std::vector<std::thread> m_workers;
+  std::mutex m_copyMutex;   // one parallel copy at a time
+  std::mutex m_mutex;       // protects the job description below
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  bool m_stop;
+  uint64_t m_generation;
+  unsigned int m_pending;
+
+  // current parallel copy job
+  uint8_t * m_dst;
+  const uint8_t * m_src;
+  uint64_t m_numBytes;
+  uint64_t m_partBytes;
+  bool m_streamStores;
+
+  void parallelCopy(void * dst, const void * src, uint64_t numBytes, bool streamStores) {
+    std::lock_guard<std::mutex> copyLock(m_copyMutex);
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_dst = (uint8_t *) dst;
+      m_src = (const uint8_t *) src;
+      m_numBytes = numBytes;
+      m_streamStores = streamStores;
+      // part boundaries on 64-byte multiples to keep the wide loop busy
+      m_partBytes = ((numBytes + m_numThreads - 1) / m_numThreads + 63) & ~(uint64_t) 63;
+      m_pending = m_numThreads - 1;
+      m_generation++;
+    }
+    m_wake.notify_all();
+    copyPart(0);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(m_pending != 0)
+      m_done.wait(lock);
+  }
+
+  void copyPart(unsigned int part) {
+    uint64_t begin = part * m_partBytes;
+    if(begin >= m_numBytes) return;
+    uint64_t end = begin + m_partBytes;
+    if(end > m_numBytes) end = m_numBytes;
+    wideCopy(m_dst + begin, m_src + begin, end - begin, m_streamStores);
+  }
+
+  void worker(unsigned int part) {
+    uint64_t seenGeneration = 0;
+    while(true) {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while(!m_stop && m_generation == seenGeneration)
+          m_wake.wait(lock);
+        if(m_stop) return;
+        seenGeneration = m_generation;
+      }
+      copyPart(part);
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(--m_pending == 0) m_done.notify_one();
+      }
+    }
+  }
+
+private:
+  // owns worker threads, no copies
+  CopyEngine(const CopyEngine &);
+  CopyEngine & operator=(const CopyEngine &);
+};
+
+#endif // COPYENGINE_HPP
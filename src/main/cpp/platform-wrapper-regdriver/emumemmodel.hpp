@@ -0,0 +1,299 @@
+#ifndef EMUMEMMODEL_HPP
+#define EMUMEMMODEL_HPP
+
+// cycle-level DRAM timing model for the emulator drivers. the emulated
+// TesterWrapper memory has a fixed request pipeline and can otherwise return
+// one beat per port per cycle, which is far more bandwidth than any real
+// platform has. with a model attached, the driver reports every request and
+// data beat on the accelerator memory ports, and the model stalls the data
+// beats of each port until they would have been available on the platform:
+//
+// - latency from request to first data beat
+// - bandwidth per port and direction, and aggregate over all ports
+// - banks with one open row each, requests to another row pay a row miss
+//
+// all times are in accelerator clock cycles. the wrapper's own request
+// pipeline is ~16 cycles, latencies below that cannot be modelled.
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <deque>
+
+struct EmuMemParams {
+  unsigned int readLatency;     // read request to first data beat, on a row hit
+  unsigned int writeLatency;    // write request to first accepted data beat
+  double portBytesPerCycle;     // per port and direction, 0 for unlimited
+  double totalBytesPerCycle;    // shared by all ports, 0 for unlimited
+  unsigned int numBanks;        // 0 disables the bank model
+  unsigned int rowBytes;        // bytes per row, across the whole data bus
+  unsigned int rowMissCycles;   // extra latency to close a row and open another
+};
+
+class EmuMemModel {
+public:
+  // presets. these are approximate and worth calibrating against
+  // TestMemLatency runs on the actual hardware.
+
+  // same behaviour as without a model
+  static EmuMemParams ideal() {
+    EmuMemParams p = {0, 0, 0, 0, 0, 0, 0};
+    return p;
+  }
+
+  // ZedBoard: 32-bit DDR3-1066 (4.2 GB/s peak) behind the 64-bit HP ports,
+  // accelerator at 100 MHz. 8 banks, 2 KB pages on each of the two x16 chips.
+  static EmuMemParams zedboardDDR3() {
+    EmuMemParams p = {32, 16, 8, 32, 8, 4096, 3};
+    return p;
+  }
+
+  // Wolverine WX690T: many 64-bit ports onto the DDR3 memory controllers,
+  // accelerator at 150 MHz. long pipelined latency, many banks.
+  static EmuMemParams wolverine() {
+    EmuMemParams p = {128, 32, 8, 192, 64, 1024, 4};
+    return p;
+  }
+
+  // preset by name ("ideal", "zedboard" or "wolverine"), e.g. taken from
+  // the EMU_MEM_MODEL environment variable
+  static EmuMemParams preset(const char * name) {
+    if(strcmp(name, "ideal") == 0) return ideal();
+    if(strcmp(name, "zedboard") == 0) return zedboardDDR3();
+    if(strcmp(name, "wolverine") == 0) return wolverine();
+    throw "Unknown memory model preset";
+  }
+
+  // throws if the model cannot work with these parameters
+  static void checkParams(const EmuMemParams & p, unsigned int beatBytes = 8) {
+    if(beatBytes == 0)
+      throw "Memory model beat size must be nonzero";
+    if(p.numBanks > 0 && p.rowBytes == 0)
+      throw "Memory model with banks needs a nonzero row size";
+  }
+
+  EmuMemModel(const EmuMemParams & p, unsigned int numPorts, unsigned int beatBytes = 8) {
+    checkParams(p, beatBytes);
+    m_p = p;
+    m_beatBytes = beatBytes;
+    m_chans.resize(2 * numPorts);
+    for(unsigned int i = 0; i < m_chans.size(); i++) {
+      m_chans[i].credit = 0;
+      m_chans[i].granted = false;
+      m_chans[i].beatFired = false;
+    }
+    m_banks.resize(p.numBanks);
+    for(unsigned int i = 0; i < m_banks.size(); i++) {
+      m_banks[i].openRow = ~(uint64_t) 0;
+      m_banks[i].busyUntil = 0;
+    }
+    m_totalCredit = 0;
+    m_cycle = 0;
+    m_rrNext = 0;
+    m_rowHits = m_rowMisses = 0;
+    m_bytesRead = m_bytesWritten = 0;
+  }
+
+  // start of a cycle: decide which ports may transfer a data beat
+  void beginCycle() {
+    m_totalCredit = addCredit(m_totalCredit, m_p.totalBytesPerCycle);
+    unsigned int n = m_chans.size();
+    for(unsigned int k = 0; k < n; k++) {
+      // rotate the starting port, so no port starves on aggregate bandwidth
+      Channel & c = m_chans[(m_rrNext + k) % n];
+      c.credit = addCredit(c.credit, m_p.portBytesPerCycle);
+      c.granted = false;
+      c.beatFired = false;
+      if(c.txns.empty() || c.txns.front().readyCycle > m_cycle)
+        continue;
+      if(m_p.portBytesPerCycle > 0 && c.credit < m_beatBytes)
+        continue;
+      if(m_p.totalBytesPerCycle > 0 && m_totalCredit < m_beatBytes)
+        continue;
+      c.granted = true;
+      c.credit -= m_beatBytes;
+      m_totalCredit -= m_beatBytes;
+    }
+    if(n > 0) m_rrNext = (m_rrNext + 1) % n;
+  }
+
+  bool readStall(unsigned int port) { return !m_chans[2*port].granted; }
+  bool writeStall(unsigned int port) { return !m_chans[2*port+1].granted; }
+
+  // events on the ports during this cycle
+  void readRequest(unsigned int port, uint64_t addr, unsigned int numBytes) {
+    request(m_chans[2*port], addr, numBytes, m_p.readLatency);
+  }
+
+  void writeRequest(unsigned int port, uint64_t addr, unsigned int numBytes) {
+    request(m_chans[2*port+1], addr, numBytes, m_p.writeLatency);
+  }
+
+  void readBeat(unsigned int port) {
+    m_chans[2*port].beatFired = true;
+    m_bytesRead += m_beatBytes;
+  }
+
+  void writeBeat(unsigned int port) {
+    m_chans[2*port+1].beatFired = true;
+    m_bytesWritten += m_beatBytes;
+  }
+
+  // end of a cycle: retire transferred beats, return unused bandwidth
+  void endCycle() {
+    for(unsigned int i = 0; i < m_chans.size(); i++) {
+      Channel & c = m_chans[i];
+      if(c.beatFired && !c.txns.empty()) {
+        if(--c.txns.front().beatsLeft == 0) c.txns.pop_front();
+      } else if(c.granted) {
+        c.credit += m_beatBytes;
+        m_totalCredit += m_beatBytes;
+      }
+      // zero-byte requests have no beats
+      while(!c.txns.empty() && c.txns.front().beatsLeft == 0) c.txns.pop_front();
+    }
+    m_cycle++;
+  }
+
+  uint64_t getRowHits() { return m_rowHits; }
+  uint64_t getRowMisses() { return m_rowMisses; }
+  uint64_t getBytesRead() { return m_bytesRead; }
+  uint64_t getBytesWritten() { return m_bytesWritten; }
+  const EmuMemParams & getParams() { return m_p; }
+
+  // serialization of the timing state (requests in flight, credits, open
+  // rows), for checkpoints. works with the same streams as SparseMem. the
+  // model restored into must have the same parameters and number of ports.
+  template <class Out> void save(Out & os) {
+    put(os, m_p.readLatency); put(os, m_p.writeLatency);
+    put(os, m_p.portBytesPerCycle); put(os, m_p.totalBytesPerCycle);
+    put(os, m_p.numBanks); put(os, m_p.rowBytes); put(os, m_p.rowMissCycles);
+    put(os, m_beatBytes);
+    put(os, (uint64_t) m_chans.size());
+    for(unsigned int i = 0; i < m_chans.size(); i++) {
+      Channel & c = m_chans[i];
+      put(os, (uint64_t) c.txns.size());
+      for(unsigned int j = 0; j < c.txns.size(); j++) {
+        put(os, c.txns[j].readyCycle);
+        put(os, c.txns[j].beatsLeft);
+      }
+      put(os, c.credit); put(os, c.granted); put(os, c.beatFired);
+    }
+    for(unsigned int i = 0; i < m_banks.size(); i++) {
+      put(os, m_banks[i].openRow);
+      put(os, m_banks[i].busyUntil);
+    }
+    put(os, m_totalCredit); put(os, m_cycle); put(os, m_rrNext);
+    put(os, m_rowHits); put(os, m_rowMisses);
+    put(os, m_bytesRead); put(os, m_bytesWritten);
+  }
+
+  template <class In> void restore(In & is) {
+    EmuMemParams p;
+    unsigned int beatBytes = 0;
+    uint64_t numChans = 0;
+    get(is, p.readLatency); get(is, p.writeLatency);
+    get(is, p.portBytesPerCycle); get(is, p.totalBytesPerCycle);
+    get(is, p.numBanks); get(is, p.rowBytes); get(is, p.rowMissCycles);
+    get(is, beatBytes);
+    get(is, numChans);
+    if(p.readLatency != m_p.readLatency || p.writeLatency != m_p.writeLatency ||
+      p.portBytesPerCycle != m_p.portBytesPerCycle || p.totalBytesPerCycle != m_p.totalBytesPerCycle ||
+      p.numBanks != m_p.numBanks || p.rowBytes != m_p.rowBytes || p.rowMissCycles != m_p.rowMissCycles ||
+      beatBytes != m_beatBytes || numChans != m_chans.size())
+      throw "Checkpoint was saved with a different memory model";
+    for(unsigned int i = 0; i < m_chans.size(); i++) {
+      Channel & c = m_chans[i];
+      uint64_t numTxns = 0;
+      get(is, numTxns);
+      c.txns.clear();
+      for(uint64_t j = 0; j < numTxns; j++) {
+        Txn t;
+        get(is, t.readyCycle);
+        get(is, t.beatsLeft);
+        c.txns.push_back(t);
+      }
+      get(is, c.credit); get(is, c.granted); get(is, c.beatFired);
+    }
+    for(unsigned int i = 0; i < m_banks.size(); i++) {
+      get(is, m_banks[i].openRow);
+      get(is, m_banks[i].busyUntil);
+    }
+    get(is, m_totalCredit); get(is, m_cycle); get(is, m_rrNext);
+    get(is, m_rowHits); get(is, m_rowMisses);
+    get(is, m_bytesRead); get(is, m_bytesWritten);
+  }
+
+protected:
+  struct Txn {
+    uint64_t readyCycle;    // first cycle a beat of this request can transfer
+    unsigned int beatsLeft;
+  };
+
+  // one per port and direction. requests are served in order, as the
+  // wrapper does
+  struct Channel {
+    std::deque<Txn> txns;
+    double credit;
+    bool granted;
+    bool beatFired;
+  };
+
+  struct Bank {
+    uint64_t openRow;
+    uint64_t busyUntil;
+  };
+
+  EmuMemParams m_p;
+  unsigned int m_beatBytes;
+  std::vector<Channel> m_chans;
+  std::vector<Bank> m_banks;
+  double m_totalCredit;
+  uint64_t m_cycle;
+  unsigned int m_rrNext;
+  uint64_t m_rowHits, m_rowMisses;
+  uint64_t m_bytesRead, m_bytesWritten;
+
+  template <class Out, class T> static void put(Out & os, const T & v) {
+    os.write((const char *) &v, sizeof(T));
+  }
+
+  template <class In, class T> static void get(In & is, T & v) {
+    is.read((char *) &v, sizeof(T));
+  }
+
+  // token bucket: unused bandwidth carries over for at most one beat
+  double addCredit(double credit, double rate) {
+    if(rate <= 0) return 0;
+    double cap = (rate > m_beatBytes) ? rate : m_beatBytes;
+    credit += rate;
+    return (credit > cap) ? cap : credit;
+  }
+
+  void request(Channel & c, uint64_t addr, unsigned int numBytes, unsigned int latency) {
+    Txn t;
+    t.beatsLeft = (numBytes + m_beatBytes - 1) / m_beatBytes;
+    uint64_t start = m_cycle;
+    if(m_p.numBanks > 0) {
+      uint64_t rowInd = addr / m_p.rowBytes;
+      uint64_t row = rowInd / m_p.numBanks;
+      // xor the row into the bank index like the memory controllers do, so
+      // that buffers at large power-of-two offsets don't share one bank
+      Bank & b = m_banks[(rowInd ^ row) % m_p.numBanks];
+      if(b.busyUntil > start) start = b.busyUntil;
+      if(b.openRow != row) {
+        start += m_p.rowMissCycles;
+        b.openRow = row;
+        m_rowMisses++;
+      } else {
+        m_rowHits++;
+      }
+      // the bank is occupied while the burst is transferred
+      b.busyUntil = start + t.beatsLeft;
+    }
+    t.readyCycle = start + latency;
+    c.txns.push_back(t);
+  }
+};
+
+#endif // EMUMEMMODEL_HPP
@@ -0,0 +1,289 @@
+#ifndef INSTRUMENTEDREGDRIVER_HPP
+#define INSTRUMENTEDREGDRIVER_HPP
+
+// decorator that forwards to any WrapperRegDriver and records, for each kind
+// of call (register accesses, buffer copies, allocation, attach, waits...),
+// the number of calls, the bytes moved and a histogram of the host time
+// spent in the call. it shows where the host time of a run goes.
+//
+// the platform-*.cpp files wrap their driver in one of these when the
+// REGDRIVER_STATS environment variable is set, and deinitPlatform writes the
+// summary to stderr (REGDRIVER_STATS=1) or to the file the variable names.
+// when it is not set the driver is not wrapped at all, so there is no
+// overhead. the counters are atomic, the decorator can be shared between
+// threads if the wrapped driver can.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include "wrapperregdriver.h"
+
+class InstrumentedRegDriver : public WrapperRegDriver {
+public:
+  enum Op {
+    opReadReg, opWriteReg, opReadRegs, opWriteRegs,
+    opCopyToAccel, opCopyToHost, opLoadFile, opSyncForAccel, opSyncForHost,
+    opAlloc, opDealloc, opAttach, opDetach, opWait,
+    numOps
+  };
+
+  // latency histogram buckets: bucket i counts calls taking [2^i, 2^(i+1)) ns
+  static const unsigned int numBuckets = 40;
+
+  // wraps driver if REGDRIVER_STATS is set, returns 0 otherwise
+  static InstrumentedRegDriver * fromEnv(WrapperRegDriver * driver) {
+    const char * env = getenv("REGDRIVER_STATS");
+    std::string dest = env ? env : "";
+    if(dest.empty() || dest == "0") return 0;
+    InstrumentedRegDriver * ret = new InstrumentedRegDriver(driver);
+    if(dest != "1") ret->m_outFile = dest;
+    return ret;
+  }
+
+  InstrumentedRegDriver(WrapperRegDriver * driver) {
+    m_driver = driver;
+    reset();
+  }
+
+  virtual ~InstrumentedRegDriver() {}
+
+  WrapperRegDriver * getWrappedDriver() { return m_driver; }
+
+  void reset() {
+    for(unsigned int i = 0; i < numOps; i++) {
+      m_stats[i].calls = 0;
+      m_stats[i].bytes = 0;
+      m_stats[i].totalNs = 0;
+      m_stats[i].maxNs = 0;
+      for(unsigned int b = 0; b < numBuckets; b++) m_stats[i].hist[b] = 0;
+    }
+  }
+
+  uint64_t getCalls(Op op) { return m_stats[op].calls; }
+  uint64_t getBytes(Op op) { return m_stats[op].bytes; }
+  uint64_t getTotalNs(Op op) { return m_stats[op].totalNs; }
+  uint64_t getMaxNs(Op op) { return m_stats[op].maxNs; }
+  uint64_t getHistogram(Op op, unsigned int bucket) { return m_stats[op].hist[bucket]; }
+
+  static const char * opName(unsigned int op) {
+    static const char * names[numOps] = {
+      "readReg", "writeReg", "readRegs", "writeRegs",
+      "copyHostToAccel", "copyAccelToHost", "loadFileToAccel",
+      "syncForAccel", "syncForHost", "alloc", "dealloc", "attach", "detach",
+      "waitForCompletion"
+    };
+    return names[op];
+  }
+
+  // upper bound of the time within which the given fraction of the calls
+  // finished, from the histogram
+  uint64_t percentileNs(Op op, double frac) {
+    uint64_t calls = m_stats[op].calls;
+    uint64_t seen = 0;
+    for(unsigned int b = 0; b < numBuckets; b++) {
+      seen += m_stats[op].hist[b];
+      if(seen > 0 && seen >= frac * calls) {
+        uint64_t bound = (uint64_t) 1 << (b + 1);
+        return (bound < m_stats[op].maxNs) ? bound : (uint64_t) m_stats[op].maxNs;
+      }
+    }
+    return m_stats[op].maxNs;
+  }
+
+  // one line per kind of call that was made, then the non-empty histogram
+  // buckets of each
+  void writeSummary(std::ostream & os) {
+    os << "=== register driver stats" << std::endl;
+    os << std::left << std::setw(18) << "call" << std::right;
+    os << std::setw(10) << "calls" << std::setw(14) << "bytes";
+    os << std::setw(12) << "total_ms" << std::setw(10) << "mean_us";
+    os << std::setw(10) << "p50_us" << std::setw(10) << "p99_us";
+    os << std::setw(12) << "max_us" << std::endl;
+    for(unsigned int i = 0; i < numOps; i++) {
+      Stats & s = m_stats[i];
+      uint64_t calls = s.calls;
+      if(calls == 0) continue;
+      os << std::left << std::setw(18) << opName(i) << std::right;
+      os << std::setw(10) << calls << std::setw(14) << s.bytes;
+      os << std::fixed << std::setprecision(3);
+      os << std::setw(12) << s.totalNs / 1e6;
+      os << std::setw(10) << s.totalNs / 1e3 / calls;
+      os << std::setw(10) << percentileNs((Op) i, 0.5) / 1e3;
+      os << std::setw(10) << percentileNs((Op) i, 0.99) / 1e3;
+      os << std::setw(12) << s.maxNs / 1e3 << std::endl;
+      os.unsetf(std::ios::floatfield);
+    }
+    for(unsigned int i = 0; i < numOps; i++) {
+      if(m_stats[i].calls == 0) continue;
+      os << opName(i) << " histogram (<ns:calls):";
+      for(unsigned int b = 0; b < numBuckets; b++)
+        if(m_stats[i].hist[b] != 0)
+          os << " " << ((uint64_t) 1 << (b + 1)) << ":" << m_stats[i].hist[b];
+      os << std::endl;
+    }
+  }
+
+  // writes the summary where REGDRIVER_STATS asked for it
+  void report() {
+    if(m_outFile.empty()) {
+      writeSummary(std::cerr);
+      return;
+    }
+    std::ofstream out(m_outFile.c_str());
+    if(!out)
+      throw "Could not open register driver stats file";
+    writeSummary(out);
+  }
+
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
+    uint64_t start = nowNs();
+    m_driver->copyBufferHostToAccel(hostBuffer, accelBuffer, numBytes);
+    record(opCopyToAccel, start, numBytes);
+  }
+
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
+    uint64_t start = nowNs();
+    m_driver->copyBufferAccelToHost(accelBuffer, hostBuffer, numBytes);
+    record(opCopyToHost, start, numBytes);
+  }
+
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
+    uint64_t start = nowNs();
+    void * ret = m_driver->allocAccelBuffer(numBytes);
+    record(opAlloc, start, numBytes);
+    return ret;
+  }
+
+  virtual void deallocAccelBuffer(void * buffer) {
+    uint64_t start = nowNs();
+    m_driver->deallocAccelBuffer(buffer);
+    record(opDealloc, start, 0);
+  }
+
+  virtual void * getHostPointer(void * accelBuffer) {
+    return m_driver->getHostPointer(accelBuffer);
+  }
+
+  virtual void syncBufferForAccel(void * accelBuffer, uint64_t numBytes) {
+    uint64_t start = nowNs();
+    m_driver->syncBufferForAccel(accelBuffer, numBytes);
+    record(opSyncForAccel, start, numBytes);
+  }
+
+  virtual void syncBufferForHost(void * accelBuffer, uint64_t numBytes) {
+    uint64_t start = nowNs();
+    m_driver->syncBufferForHost(accelBuffer, numBytes);
+    record(opSyncForHost, start, numBytes);
+  }
+
+  // counted as a whole, the copies the wrapped driver makes for it are not
+  virtual uint64_t loadFileToAccel(const char * fileName, void * accelBuffer) {
+    uint64_t start = nowNs();
+    uint64_t ret = m_driver->loadFileToAccel(fileName, accelBuffer);
+    record(opLoadFile, start, ret);
+    return ret;
+  }
+
+  virtual bool supportsConcurrentCopy() { return m_driver->supportsConcurrentCopy(); }
+  virtual bool supportsConcurrentRegAccess() { return m_driver->supportsConcurrentRegAccess(); }
+
+  virtual void attach(const char * name) {
+    uint64_t start = nowNs();
+    m_driver->attach(name);
+    record(opAttach, start, 0);
+  }
+
+  virtual void detach() {
+    uint64_t start = nowNs();
+    m_driver->detach();
+    record(opDetach, start, 0);
+  }
+
+  virtual void setVolatileReg(unsigned int regInd) {
+    m_driver->setVolatileReg(regInd);
+  }
+
+  virtual void setInterruptReg(unsigned int regInd) {
+    m_driver->setInterruptReg(regInd);
+  }
+
+  virtual int getInterruptFd() { return m_driver->getInterruptFd(); }
+  virtual void clearInterrupt() { m_driver->clearInterrupt(); }
+
+  virtual void writeReg(unsigned int regInd, AccelReg regValue) {
+    uint64_t start = nowNs();
+    m_driver->writeReg(regInd, regValue);
+    record(opWriteReg, start, sizeof(AccelReg));
+  }
+
+  virtual AccelReg readReg(unsigned int regInd) {
+    uint64_t start = nowNs();
+    AccelReg ret = m_driver->readReg(regInd);
+    record(opReadReg, start, sizeof(AccelReg));
+    return ret;
+  }
+
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    uint64_t start = nowNs();
+    m_driver->writeRegs(numRegs, regInds, regValues);
+    record(opWriteRegs, start, numRegs * sizeof(AccelReg));
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    uint64_t start = nowNs();
+    m_driver->readRegs(numRegs, regInds, regValues);
+    record(opReadRegs, start, numRegs * sizeof(AccelReg));
+  }
+
+  // forwarded as a whole, so the emulator fast paths are kept
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    uint64_t start = nowNs();
+    bool ret = m_driver->waitForCompletion(regInd, expValue, timeoutUs);
+    record(opWait, start, 0);
+    m_lastWaitUs = m_driver->getLastWaitTimeUs();
+    return ret;
+  }
+
+protected:
+  struct Stats {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<uint64_t> hist[numBuckets];
+  };
+
+  WrapperRegDriver * m_driver;
+  Stats m_stats[numOps];
+  std::string m_outFile;
+
+  static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void record(Op op, uint64_t start, uint64_t numBytes) {
+    uint64_t ns = nowNs() - start;
+    Stats & s = m_stats[op];
+    s.calls.fetch_add(1, std::memory_order_relaxed);
+    s.bytes.fetch_add(numBytes, std::memory_order_relaxed);
+    s.totalNs.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t prevMax = s.maxNs.load(std::memory_order_relaxed);
+    while(ns > prevMax && !s.maxNs.compare_exchange_weak(prevMax, ns, std::memory_order_relaxed)) {}
+    unsigned int b = 0;
+    while(b + 1 < numBuckets && (ns >> (b + 1)) != 0) b++;
+    s.hist[b].fetch_add(1, std::memory_order_relaxed);
+  }
+
+private:
+  // holds the counters, no copies
+  InstrumentedRegDriver(const InstrumentedRegDriver &);
+  InstrumentedRegDriver & operator=(const InstrumentedRegDriver &);
+};
+
+#endif // INSTRUMENTEDREGDRIVER_HPP
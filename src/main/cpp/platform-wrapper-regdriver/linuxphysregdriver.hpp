@@ -7,7 +7,10 @@
 
 #include <stdint.h>
 #include "axiregdriver.hpp"
+#include "bufferallocator.hpp"
+#include "copyengine.hpp"
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -19,11 +22,9 @@ extern void loadBitfile(const char * accelName);
 
 class LinuxPhysRegDriver : public AXIRegDriver {
 public:
-  LinuxPhysRegDriver(void * baseAddrPhys, void * memBufBasePhys, unsigned int memBufBytes)
-    : AXIRegDriver(baseAddrPhys) {
-    unsigned int page_addr, page_offset;
-    void *ptr;
-    unsigned int page_size=sysconf(_SC_PAGESIZE);
+  LinuxPhysRegDriver(void * baseAddrPhys, void * memBufBasePhys, uint64_t memBufBytes)
+    : AXIRegDriver(baseAddrPhys), m_allocator((uintptr_t) memBufBasePhys, memBufBytes) {
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
     m_memBufSize = memBufBytes;
     // cout << "page size " << page_size << endl;
 
@@ -34,55 +35,113 @@ public:
     }
 
     /* mmap the device into memory */
-    // TODO fix for 64-bit addresses, probably 32-bit only for now
-    unsigned int baseAddrVal = (unsigned int) baseAddrPhys;
-    page_addr = (baseAddrVal & (~(page_size-1)));
-    page_offset = baseAddrVal - page_addr;
-    m_pagePtr = mmap(NULL, page_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, page_addr);
-    m_baseAddr = (AccelReg *)(((unsigned int) m_pagePtr) + page_offset);
+    // sizes are kept in 64 bits. physical addresses are passed as void *,
+    // so a 32-bit host can only use windows below 4 GB; building there with
+    // -D_FILE_OFFSET_BITS=64 only widens the mmap offset
+    uint64_t baseAddrVal = (uintptr_t) baseAddrPhys;
+    uint64_t page_addr = baseAddrVal & ~(page_size-1);
+    uint64_t page_offset = baseAddrVal - page_addr;
+    m_pagePtr = mmap(NULL, page_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (off_t) page_addr);
+    if (m_pagePtr == MAP_FAILED) {
+        close(fd);
+        throw "Could not mmap register file";
+    }
+    m_baseAddr = (uint32_t *)((uint8_t *) m_pagePtr + page_offset);
 
     // assume memBufBase always starts at page boundary
-    m_memBufBasePhys = (unsigned int) memBufBasePhys;
-    m_memBufBaseVirt = mmap(NULL, m_memBufSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (unsigned int)memBufBasePhys);
-    m_currentAllocBase = (unsigned int) m_memBufBasePhys;
+    m_memBufBasePhys = (uintptr_t) memBufBasePhys;
+    m_memBufBaseVirt = mmap(NULL, (size_t) m_memBufSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, (off_t) m_memBufBasePhys);
     // cout << "memBufBase returned: " << hex << m_memBufBaseVirt << dec << endl;
-
     close(fd);
+    if (m_memBufBaseVirt == MAP_FAILED) {
+        munmap(m_pagePtr, page_size);
+        throw "Could not mmap accel buffer window";
+    }
   }
 
   virtual ~LinuxPhysRegDriver() {
-    unsigned int page_size=sysconf(_SC_PAGESIZE);
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
     munmap(m_pagePtr, page_size);
-    munmap(m_memBufBaseVirt, m_memBufSize);
+    munmap(m_memBufBaseVirt, (size_t) m_memBufSize);
   }
 
   // functions for host-accelerator buffer management
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
-    memcpy(phys2virt(accelBuffer), hostBuffer, numBytes);
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
+    m_copyEngine.copy(phys2virt(accelBuffer), hostBuffer, numBytes, true);
   }
 
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
-    memcpy(hostBuffer, phys2virt(accelBuffer), numBytes);
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
+    m_copyEngine.copy(hostBuffer, phys2virt(accelBuffer), numBytes, false);
   }
 
-  virtual void * allocAccelBuffer(unsigned int numBytes) {
-    // align base to 64 bytes
-    if(m_currentAllocBase % 64 != 0)
-      m_currentAllocBase += 64 - (m_currentAllocBase % 64);
-    unsigned int ret = m_currentAllocBase;
-    // increment alloc base
-    m_currentAllocBase += numBytes;
-    if(m_currentAllocBase >= m_memBufBasePhys + m_memBufSize)
-      throw "allocAccelBuffer out of memory!";
-    return (void *) ret;
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
+    // buffers are 64-byte aligned
+    return (void *) m_allocator.alloc(numBytes);
   }
 
   virtual void deallocAccelBuffer(void * buffer) {
-    (void) buffer;
-    // currently does nothing
-    // TODO implement a proper dealloc if we have lots of dynamic alloc/delloc
+    m_allocator.dealloc((uintptr_t) buffer);
+  }
+
+  const BufferAllocator & getAllocator() { return m_allocator; }
+
+  // read the file straight into the mapped buffer window. accelBuffer must
+  // be a buffer from allocAccelBuffer, and the file must fit into it.
+  virtual uint64_t loadFileToAccel(const char * fileName, void * accelBuffer) {
+    uintptr_t bufAddr = (uintptr_t) accelBuffer;
+    if(!m_allocator.isAllocated(bufAddr))
+      throw "loadFileToAccel target is not an accel buffer";
+    uint64_t bufBytes = m_allocator.allocSize(bufAddr);
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0)
+      throw "Could not open file";
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < 0) {
+      close(fd);
+      throw "Could not get file size";
+    }
+    uint64_t fileBytes = st.st_size;
+    if(fileBytes > bufBytes) {
+      close(fd);
+      throw "File does not fit into the accel buffer";
+    }
+    uint8_t * dst = (uint8_t *) phys2virt(accelBuffer);
+    uint64_t total = 0;
+    while(total < fileBytes) {
+      uint64_t n = fileBytes - total;
+      ssize_t r = read(fd, dst + total, (n < (1 << 30)) ? n : (1 << 30));
+      if(r <= 0) {
+        close(fd);
+        throw "Read error in loadFileToAccel";
+      }
+      total += r;
+    }
+    close(fd);
+    return total;
   }
 
+  // copy strategy thresholds can be tuned through the engine
+  CopyEngine & getCopyEngine() { return m_copyEngine; }
+
+  // the whole buffer window is already mapped into our address space
+  virtual void * getHostPointer(void * accelBuffer) {
+    return phys2virt(accelBuffer);
+  }
+
+  // the window is mapped uncached (O_SYNC), so no cache maintenance is needed,
+  // but the memory accesses must complete before/after the register accesses
+  // that start the accelerator or signal its completion
+  virtual void syncBufferForAccel(void * accelBuffer, uint64_t numBytes) {
+    __sync_synchronize();
+  }
+
+  virtual void syncBufferForHost(void * accelBuffer, uint64_t numBytes) {
+    __sync_synchronize();
+  }
+
+  // copies only touch the buffer window, registers live in a separate mapping
+  virtual bool supportsConcurrentCopy() { return true; }
+
   virtual void attach(const char * name) {
     // call loadBitfile, defined in platform*.cpp
     loadBitfile(name);
@@ -91,14 +150,14 @@ public:
 protected:
   void * m_pagePtr;
   void * m_memBufBaseVirt;
-  unsigned int m_memBufBasePhys;
-  unsigned int m_memBufSize;
-  unsigned int m_currentAllocBase;
+  uint64_t m_memBufBasePhys;
+  uint64_t m_memBufSize;
+  BufferAllocator m_allocator;
+  CopyEngine m_copyEngine;
 
   void * phys2virt(void * physBufAddr) {
-    unsigned int virtBuf = (unsigned int) m_memBufBaseVirt;
-    virtBuf += ((unsigned int) physBufAddr) - m_memBufBasePhys;
-    return (void *) virtBuf;
+    uint64_t offset = (uintptr_t) physBufAddr - m_memBufBasePhys;
+    return (void *) ((uint8_t *) m_memBufBaseVirt + offset);
   }
 };
 
@@ -0,0 +1,71 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+// read-only memory mapping of a whole file, for loading (possibly multi-GB)
+// datasets without reading them into a heap buffer first
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+class MappedFile {
+public:
+  MappedFile(const char * fileName) {
+    m_data = 0;
+    m_size = 0;
+    int fd = open(fileName, O_RDONLY);
+    if(fd < 0)
+      throw "Could not open file";
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+      close(fd);
+      throw "Could not stat file";
+    }
+    m_size = st.st_size;
+    if(m_size > 0) {
+      void * p = mmap(NULL, (size_t) m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(p == MAP_FAILED) {
+        close(fd);
+        throw "Could not mmap file";
+      }
+      m_data = (const uint8_t *) p;
+      // the file is typically streamed through once
+      madvise(p, (size_t) m_size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if(m_data) munmap((void *) m_data, (size_t) m_size);
+  }
+
+  const uint8_t * data() const { return m_data; }
+  uint64_t size() const { return m_size; }
+
+  // drop already consumed pages from the mapping to keep the resident set
+  // small for large files. offset must be page-aligned.
+  void release(uint64_t offset, uint64_t numBytes) {
+    if(m_data && numBytes > 0)
+      madvise((void *) (m_data + offset), (size_t) numBytes, MADV_DONTNEED);
+  }
+
+  static uint64_t sizeOf(const char * fileName) {
+    struct stat st;
+    if(stat(fileName, &st) != 0)
+      throw "Could not stat file";
+    return st.st_size;
+  }
+
+protected:
+  const uint8_t * m_data;
+  uint64_t m_size;
+
+private:
+  // owns the mapping, no copies
+  MappedFile(const MappedFile &);
+  MappedFile & operator=(const MappedFile &);
+};
+
+#endif // MAPPEDFILE_HPP
@@ -0,0 +1,96 @@
+#ifndef PERFSERIES_HPP
+#define PERFSERIES_HPP
+
+// time series of performance counter snapshots. the generated accelerator
+// drivers read all their perf_* outputs in one batch with snapshotPerf(), and
+// samplePerf() appends such a snapshot to a series, e.g. from a polling loop:
+//
+//   PerfSeries series = t.makePerfSeries();
+//   while(!t.wait_finished(1, 1000)) t.samplePerf(series);
+//   t.samplePerf(series);
+//   series.save("perf.csv");
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+
+struct PerfSnapshot {
+  uint64_t timestampUs;             // monotonic host time, see PerfSeries::timestampUs
+  std::vector<uint64_t> values;     // in the order of the counter names
+};
+
+class PerfSeries {
+public:
+  PerfSeries(const std::vector<std::string> & names) {
+    m_names = names;
+  }
+
+  static uint64_t timestampUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void add(const PerfSnapshot & s) {
+    if(s.values.size() != m_names.size())
+      throw "PerfSnapshot does not match the counters of the series";
+    m_samples.push_back(s);
+  }
+
+  void clear() { m_samples.clear(); }
+  unsigned int size() const { return m_samples.size(); }
+  const PerfSnapshot & operator[](unsigned int i) const { return m_samples[i]; }
+  const std::vector<std::string> & getNames() const { return m_names; }
+
+  // one row per sample, time in us relative to the first sample
+  void writeCSV(std::ostream & os) const {
+    os << "time_us";
+    for(unsigned int i = 0; i < m_names.size(); i++)
+      os << "," << m_names[i];
+    os << std::endl;
+    for(unsigned int s = 0; s < m_samples.size(); s++) {
+      os << relTime(s);
+      for(unsigned int i = 0; i < m_names.size(); i++)
+        os << "," << m_samples[s].values[i];
+      os << std::endl;
+    }
+  }
+
+  // {"counters": [names], "samples": [{"time_us": t, "values": [...]}, ...]}
+  void writeJSON(std::ostream & os) const {
+    os << "{\"counters\": [";
+    for(unsigned int i = 0; i < m_names.size(); i++)
+      os << (i ? ", " : "") << "\"" << m_names[i] << "\"";
+    os << "], \"samples\": [";
+    for(unsigned int s = 0; s < m_samples.size(); s++) {
+      os << (s ? ",\n  " : "\n  ") << "{\"time_us\": " << relTime(s) << ", \"values\": [";
+      for(unsigned int i = 0; i < m_names.size(); i++)
+        os << (i ? ", " : "") << m_samples[s].values[i];
+      os << "]}";
+    }
+    os << "\n]}" << std::endl;
+  }
+
+  // JSON if the file name ends in .json, CSV otherwise
+  void save(const char * fileName) const {
+    std::ofstream out(fileName);
+    if(!out)
+      throw "Could not open performance counter output file";
+    size_t len = strlen(fileName);
+    if(len >= 5 && strcmp(fileName + len - 5, ".json") == 0) writeJSON(out);
+    else writeCSV(out);
+  }
+
+protected:
+  std::vector<std::string> m_names;
+  std::vector<PerfSnapshot> m_samples;
+
+  uint64_t relTime(unsigned int s) const {
+    return m_samples[s].timestampUs - m_samples[0].timestampUs;
+  }
+};
+
+#endif // PERFSERIES_HPP
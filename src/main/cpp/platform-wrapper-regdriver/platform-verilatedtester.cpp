@@ -2,17 +2,32 @@
 // note that this assumes the peripheral lives at address 0x43c00000
 
 #include "platform.h"
+#include <mutex>
 #include "verilatedtesterdriver.hpp"
+#include "instrumentedregdriver.hpp"
 
 VerilatedTesterRegDriver * platform = 0;
+// wraps platform when REGDRIVER_STATS is set
+InstrumentedRegDriver * instrumented = 0;
+// initPlatform may be called from several threads
+std::mutex platformMutex;
 
 WrapperRegDriver * initPlatform() {
+  std::lock_guard<std::mutex> lock(platformMutex);
   if(!platform) {
     platform = new VerilatedTesterRegDriver(); // real setup done inside attach()
   }
+  if(!instrumented) instrumented = InstrumentedRegDriver::fromEnv(platform);
+  if(instrumented) return (WrapperRegDriver *) instrumented;
   return (WrapperRegDriver *) platform;
 }
 
 void deinitPlatform(WrapperRegDriver * driver) {
+  std::lock_guard<std::mutex> lock(platformMutex);
+  if(instrumented) {
+    instrumented->report();
+    delete instrumented;
+    instrumented = 0;
+  }
   // TODO deinit tester?
 }
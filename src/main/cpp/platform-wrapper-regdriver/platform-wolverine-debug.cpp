@@ -2,18 +2,33 @@
 // debug variant using the AEG registers
 
 #include "platform.h"
+#include <mutex>
 #include "wolverineregdriverdebug.hpp"
+#include "instrumentedregdriver.hpp"
 
 WolverineRegDriverDebug * platform = 0;
+// wraps platform when REGDRIVER_STATS is set
+InstrumentedRegDriver * instrumented = 0;
+// initPlatform may be called from several threads
+std::mutex platformMutex;
 
 WrapperRegDriver * initPlatform() {
+  std::lock_guard<std::mutex> lock(platformMutex);
   if(!platform) {
     platform = new WolverineRegDriverDebug();
   }
+  if(!instrumented) instrumented = InstrumentedRegDriver::fromEnv(platform);
+  if(instrumented) return (WrapperRegDriver *) instrumented;
   return (WrapperRegDriver *) platform;
 }
 
 void deinitPlatform(WrapperRegDriver * driver) {
   (void) driver;
+  std::lock_guard<std::mutex> lock(platformMutex);
+  if(instrumented) {
+    instrumented->report();
+    delete instrumented;
+    instrumented = 0;
+  }
   delete platform;
 }
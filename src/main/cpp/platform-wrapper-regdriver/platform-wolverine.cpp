@@ -1,18 +1,33 @@
 // platform init-deinit functions for the Convey Wolverine WX690T
 
 #include "platform.h"
+#include <mutex>
 #include "wolverineregdriver.hpp"
+#include "instrumentedregdriver.hpp"
 
 WolverineRegDriver * platform = 0;
+// wraps platform when REGDRIVER_STATS is set
+InstrumentedRegDriver * instrumented = 0;
+// initPlatform may be called from several threads
+std::mutex platformMutex;
 
 WrapperRegDriver * initPlatform() {
+  std::lock_guard<std::mutex> lock(platformMutex);
   if(!platform) {
     platform = new WolverineRegDriver();
   }
+  if(!instrumented) instrumented = InstrumentedRegDriver::fromEnv(platform);
+  if(instrumented) return (WrapperRegDriver *) instrumented;
   return (WrapperRegDriver *) platform;
 }
 
 void deinitPlatform(WrapperRegDriver * driver) {
   (void) driver;
+  std::lock_guard<std::mutex> lock(platformMutex);
+  if(instrumented) {
+    instrumented->report();
+    delete instrumented;
+    instrumented = 0;
+  }
   delete platform;
 }
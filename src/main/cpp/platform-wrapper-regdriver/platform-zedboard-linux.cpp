@@ -12,7 +12,10 @@ env set bootargs "console=ttyPS0,115200 root=/dev/mmcblk0p2 rw rootwait earlypri
 */
 
 #include "platform.h"
+#include <mutex>
 #include "linuxphysregdriver.hpp"
+#include "uioregdriver.hpp"
+#include "instrumentedregdriver.hpp"
 #include <iostream>
 #include <string>
 using namespace std;
@@ -25,15 +28,34 @@ extern "C" {
 }
 
 LinuxPhysRegDriver * platform = 0;
+// wraps platform when REGDRIVER_STATS is set
+InstrumentedRegDriver * instrumented = 0;
+// initPlatform may be called from several threads
+std::mutex platformMutex;
 
 WrapperRegDriver * initPlatform() {
+  std::lock_guard<std::mutex> lock(platformMutex);
   if(!platform) {
-    platform = new LinuxPhysRegDriver((void *) 0x43c00000, (void *) 0x10000000, 256 * 1024 * 1024);
+    // with the completion interrupt exposed as a UIO device (e.g.
+    // ZYNQ_UIO_DEVICE=/dev/uio0), waits sleep instead of polling
+    const char * uioDevice = getenv("ZYNQ_UIO_DEVICE");
+    if(uioDevice)
+      platform = new UIORegDriver(uioDevice, (void *) 0x43c00000, (void *) 0x10000000, 256 * 1024 * 1024);
+    else
+      platform = new LinuxPhysRegDriver((void *) 0x43c00000, (void *) 0x10000000, 256 * 1024 * 1024);
   }
+  if(!instrumented) instrumented = InstrumentedRegDriver::fromEnv(platform);
+  if(instrumented) return (WrapperRegDriver *) instrumented;
   return (WrapperRegDriver *) platform;
 }
 
 void deinitPlatform(WrapperRegDriver * driver) {
+  std::lock_guard<std::mutex> lock(platformMutex);
+  if(instrumented) {
+    instrumented->report();
+    delete instrumented;
+    instrumented = 0;
+  }
   // TODO doing a delete here causes the zedboard to go in a loop, debug this
 }
 
@@ -0,0 +1,230 @@
+#ifndef SHADOWREGDRIVER_HPP
+#define SHADOWREGDRIVER_HPP
+
+// decorator that keeps a host-side shadow copy of the registers written
+// through it, for platforms where every register access is expensive (e.g.
+// the Wolverine, where each one is a round trip through the firmware):
+// - writes of the value a register already holds are elided
+// - with setDeferWrites(true), writes are held back and coalesced (the last
+//   value per register wins), and issued as one writeRegs batch on commit()
+// - writes to volatile registers are never cached. these are register 0
+//   (the accelerator reset) and whatever the generated accelerator drivers
+//   mark with setVolatileReg, i.e. their single-bit control inputs such as
+//   start. pending writes are committed before a volatile write, so
+//   configure() followed by start behaves as before.
+// - pending writes are committed before any register read or wait, since
+//   the accelerator's outputs may depend on them. reads are not cached.
+// attach, detach and writes to register 0 drop the shadow copy.
+//
+//   ShadowRegDriver shadow(platform);
+//   TestSum t(&shadow);
+//
+// the destructor commits pending writes to the wrapped driver, so destroy
+// the shadow before deinitPlatform deletes the platform driver. it ignores
+// errors from that commit, call commit() explicitly to get them.
+// not thread-safe, wrap a ThreadSafeRegDriver in it rather than the reverse
+// if the shadow should be shared between threads.
+
+#include <vector>
+#include "wrapperregdriver.h"
+
+class ShadowRegDriver : public WrapperRegDriver {
+public:
+  ShadowRegDriver(WrapperRegDriver * driver) {
+    m_driver = driver;
+    m_deferWrites = false;
+    m_elidedWrites = 0;
+    m_issuedWrites = 0;
+  }
+
+  virtual ~ShadowRegDriver() {
+    // must not throw, this may run during unwinding
+    try {
+      commit();
+    } catch(...) {
+    }
+  }
+
+  WrapperRegDriver * getWrappedDriver() { return m_driver; }
+
+  // hold writes back until commit() (or a volatile write, read or wait)
+  void setDeferWrites(bool defer) {
+    if(!defer) commit();
+    m_deferWrites = defer;
+  }
+
+  // issues all pending writes as one batch
+  void commit() {
+    if(m_pendingInds.empty()) return;
+    std::vector<AccelReg> vals(m_pendingInds.size());
+    for(unsigned int i = 0; i < m_pendingInds.size(); i++) {
+      vals[i] = m_regs[m_pendingInds[i]].value;
+      m_regs[m_pendingInds[i]].pending = false;
+    }
+    m_driver->writeRegs(m_pendingInds.size(), &m_pendingInds[0], &vals[0]);
+    m_issuedWrites += m_pendingInds.size();
+    m_pendingInds.clear();
+  }
+
+  // forget the shadow copy, e.g. if the registers were changed behind the
+  // driver's back. pending writes are committed first.
+  void invalidate() {
+    commit();
+    for(unsigned int i = 0; i < m_regs.size(); i++) m_regs[i].known = false;
+  }
+
+  uint64_t getElidedWrites() { return m_elidedWrites; }
+  uint64_t getIssuedWrites() { return m_issuedWrites; }
+
+  virtual void setVolatileReg(unsigned int regInd) {
+    entry(regInd).isVolatile = true;
+    m_driver->setVolatileReg(regInd);
+  }
+
+  virtual void setInterruptReg(unsigned int regInd) {
+    m_driver->setInterruptReg(regInd);
+  }
+
+  virtual int getInterruptFd() { return m_driver->getInterruptFd(); }
+  virtual void clearInterrupt() { m_driver->clearInterrupt(); }
+
+  virtual void writeReg(unsigned int regInd, AccelReg regValue) {
+    writeRegs(1, &regInd, &regValue);
+  }
+
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    // what has to go out now, in order
+    std::vector<unsigned int> inds;
+    std::vector<AccelReg> vals;
+    bool invalidateAfter = false;
+    for(unsigned int i = 0; i < numRegs; i++) {
+      unsigned int r = regInds[i];
+      Entry & e = entry(r);
+      if(r == 0 || e.isVolatile) {
+        // everything written before goes out first
+        for(unsigned int p = 0; p < m_pendingInds.size(); p++) {
+          inds.push_back(m_pendingInds[p]);
+          vals.push_back(m_regs[m_pendingInds[p]].value);
+          m_regs[m_pendingInds[p]].pending = false;
+        }
+        m_pendingInds.clear();
+        inds.push_back(r);
+        vals.push_back(regValues[i]);
+        invalidateAfter = invalidateAfter || (r == 0);
+      } else if(e.known && e.value == regValues[i]) {
+        m_elidedWrites++;
+      } else if(m_deferWrites) {
+        e.known = true;
+        e.value = regValues[i];
+        if(!e.pending) m_pendingInds.push_back(r);
+        e.pending = true;
+      } else {
+        e.known = true;
+        e.value = regValues[i];
+        inds.push_back(r);
+        vals.push_back(regValues[i]);
+      }
+    }
+    if(!inds.empty()) {
+      m_driver->writeRegs(inds.size(), &inds[0], &vals[0]);
+      m_issuedWrites += inds.size();
+    }
+    // register 0 resets the accelerator
+    if(invalidateAfter) invalidate();
+  }
+
+  virtual AccelReg readReg(unsigned int regInd) {
+    commit();
+    return m_driver->readReg(regInd);
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    commit();
+    m_driver->readRegs(numRegs, regInds, regValues);
+  }
+
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    commit();
+    bool ret = m_driver->waitForCompletion(regInd, expValue, timeoutUs);
+    m_lastWaitUs = m_driver->getLastWaitTimeUs();
+    return ret;
+  }
+
+  // a new accelerator marks its own volatile registers after attaching
+  virtual void attach(const char * name) {
+    invalidate();
+    m_regs.clear();
+    m_driver->attach(name);
+  }
+
+  virtual void detach() {
+    invalidate();
+    m_driver->detach();
+  }
+
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
+    m_driver->copyBufferHostToAccel(hostBuffer, accelBuffer, numBytes);
+  }
+
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
+    m_driver->copyBufferAccelToHost(accelBuffer, hostBuffer, numBytes);
+  }
+
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
+    return m_driver->allocAccelBuffer(numBytes);
+  }
+
+  virtual void deallocAccelBuffer(void * buffer) {
+    m_driver->deallocAccelBuffer(buffer);
+  }
+
+  virtual void * getHostPointer(void * accelBuffer) {
+    return m_driver->getHostPointer(accelBuffer);
+  }
+
+  virtual void syncBufferForAccel(void * accelBuffer, uint64_t numBytes) {
+    m_driver->syncBufferForAccel(accelBuffer, numBytes);
+  }
+
+  virtual void syncBufferForHost(void * accelBuffer, uint64_t numBytes) {
+    m_driver->syncBufferForHost(accelBuffer, numBytes);
+  }
+
+  virtual uint64_t loadFileToAccel(const char * fileName, void * accelBuffer) {
+    return m_driver->loadFileToAccel(fileName, accelBuffer);
+  }
+
+  virtual bool supportsConcurrentCopy() { return m_driver->supportsConcurrentCopy(); }
+  // the shadow itself is unsynchronized
+  virtual bool supportsConcurrentRegAccess() { return false; }
+
+protected:
+  struct Entry {
+    AccelReg value;
+    bool known;       // value is what the register holds (or will, if pending)
+    bool pending;     // deferred write not issued yet
+    bool isVolatile;
+  };
+
+  WrapperRegDriver * m_driver;
+  std::vector<Entry> m_regs;
+  std::vector<unsigned int> m_pendingInds;
+  bool m_deferWrites;
+  uint64_t m_elidedWrites;
+  uint64_t m_issuedWrites;
+
+  Entry & entry(unsigned int regInd) {
+    if(regInd >= m_regs.size()) {
+      Entry e = {0, false, false, false};
+      m_regs.resize(regInd + 1, e);
+    }
+    return m_regs[regInd];
+  }
+
+private:
+  // the shadow belongs to one driver, no copies
+  ShadowRegDriver(const ShadowRegDriver &);
+  ShadowRegDriver & operator=(const ShadowRegDriver &);
+};
+
+#endif // SHADOWREGDRIVER_HPP
@@ -0,0 +1,280 @@
+#ifndef SPARSEMEM_HPP
+#define SPARSEMEM_HPP
+
+// sparse backing store for the emulated main memory. the address space is
+// covered by a radix page table (like an MMU's), and pages are only allocated
+// on the first write to them, so the emulator can offer the full accelerator
+// address width while its memory use stays proportional to the pages that
+// were actually touched. reads from untouched pages return zeroes. pages
+// can also come from a private file mapping, so a checkpoint's memory is
+// only read in (and copied) as the accelerator touches it.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <sys/mman.h>
+
+class SparseMem {
+public:
+  static const unsigned int PAGE_BITS = 12;
+  static const uint64_t PAGE_BYTES = (uint64_t) 1 << PAGE_BITS;
+
+  SparseMem(unsigned int addrBits = 48) {
+    if(addrBits <= PAGE_BITS || addrBits > 63)
+      throw "SparseMem address width out of range";
+    m_addrBits = addrBits;
+    // split the page number over as few levels of <= LEVEL_BITS as possible
+    unsigned int pnBits = addrBits - PAGE_BITS;
+    m_levels = (pnBits + LEVEL_BITS - 1) / LEVEL_BITS;
+    m_topBits = pnBits - (m_levels - 1) * LEVEL_BITS;
+    m_root = newTable(m_topBits);
+    m_touchedPages = 0;
+    m_lastPageNum = ~(uint64_t) 0;
+    m_lastPage = 0;
+    m_map = 0;
+    m_mapBytes = 0;
+  }
+
+  ~SparseMem() {
+    freeTable(m_root, 0);
+    unmap();
+  }
+
+  // number of bytes addressable
+  uint64_t size() const { return (uint64_t) 1 << m_addrBits; }
+
+  uint64_t getTouchedPages() const { return m_touchedPages; }
+  uint64_t getTouchedBytes() const { return m_touchedPages * PAGE_BYTES; }
+
+  // single 64-bit word accesses, as done by the memory ports. addr is
+  // rounded down to a multiple of 8.
+  uint64_t read64(uint64_t addr) {
+    addr &= ~(uint64_t) 7;
+    const uint8_t * page = lookup(addr, false);
+    if(!page) return 0;
+    uint64_t ret;
+    memcpy(&ret, page + (addr & (PAGE_BYTES - 1)), 8);
+    return ret;
+  }
+
+  void write64(uint64_t addr, uint64_t value) {
+    addr &= ~(uint64_t) 7;
+    uint8_t * page = lookup(addr, true);
+    memcpy(page + (addr & (PAGE_BYTES - 1)), &value, 8);
+  }
+
+  // bulk accesses at any alignment
+  void read(uint64_t addr, void * buffer, uint64_t numBytes) {
+    checkRange(addr, numBytes);
+    uint8_t * dst = (uint8_t *) buffer;
+    while(numBytes > 0) {
+      uint64_t offs = addr & (PAGE_BYTES - 1);
+      uint64_t n = (PAGE_BYTES - offs < numBytes) ? (PAGE_BYTES - offs) : numBytes;
+      const uint8_t * page = lookup(addr, false);
+      if(page) memcpy(dst, page + offs, n);
+      else memset(dst, 0, n);
+      addr += n; dst += n; numBytes -= n;
+    }
+  }
+
+  void write(uint64_t addr, const void * buffer, uint64_t numBytes) {
+    checkRange(addr, numBytes);
+    const uint8_t * src = (const uint8_t *) buffer;
+    while(numBytes > 0) {
+      uint64_t offs = addr & (PAGE_BYTES - 1);
+      uint64_t n = (PAGE_BYTES - offs < numBytes) ? (PAGE_BYTES - offs) : numBytes;
+      memcpy(lookup(addr, true) + offs, src, n);
+      addr += n; src += n; numBytes -= n;
+    }
+  }
+
+  // drop all pages
+  void clear() {
+    freeTable(m_root, 0);
+    unmap();
+    m_root = newTable(m_topBits);
+    m_touchedPages = 0;
+    m_lastPageNum = ~(uint64_t) 0;
+    m_lastPage = 0;
+  }
+
+  // serialization of the touched pages, for checkpoints. works with any
+  // stream with write(const char *, n) / read(char *, n), which includes
+  // iostreams and Verilator's VerilatedSave/Restore.
+  template <class Out> void save(Out & os) {
+    std::vector<uint64_t> pages;
+    listPages(m_root, 0, 0, pages);
+    uint64_t count = pages.size();
+    os.write((const char *) &count, sizeof(count));
+    for(uint64_t i = 0; i < count; i++) {
+      os.write((const char *) &pages[i], sizeof(uint64_t));
+      os.write((const char *) lookup(pages[i], false), PAGE_BYTES);
+    }
+  }
+
+  // the same in two parts, for checkpoints that map the pages back in: the
+  // addresses of the touched pages in ascending order, and the pages
+  // themselves in that order
+  std::vector<uint64_t> getPageList() {
+    std::vector<uint64_t> pages;
+    listPages(m_root, 0, 0, pages);
+    return pages;
+  }
+
+  template <class Out> void savePages(Out & os, const std::vector<uint64_t> & pages) {
+    for(uint64_t i = 0; i < pages.size(); i++) {
+      const uint8_t * page = lookup(pages[i], false);
+      if(!page)
+        throw "SparseMem page list does not match the memory";
+      os.write((const char *) page, PAGE_BYTES);
+    }
+  }
+
+  // replace all pages with those at map, stored back to back in the order
+  // of pages. map must be a private mapping of mapBytes, which the memory
+  // owns from here on (also if this throws) and unmaps when it is cleared.
+  // writes to the pages only change this memory, not the file.
+  void mapPages(const std::vector<uint64_t> & pages, void * map, uint64_t mapBytes) {
+    clear();
+    m_map = (uint8_t *) map;
+    m_mapBytes = mapBytes;
+    if(pages.size() > mapBytes / PAGE_BYTES)
+      throw "SparseMem mapping too small for the page list";
+    for(uint64_t i = 0; i < pages.size(); i++)
+      insertPage(pages[i], m_map + i * PAGE_BYTES);
+  }
+
+  template <class In> void restore(In & is) {
+    clear();
+    uint64_t count = 0;
+    is.read((char *) &count, sizeof(count));
+    for(uint64_t i = 0; i < count; i++) {
+      uint64_t addr = 0;
+      is.read((char *) &addr, sizeof(addr));
+      checkRange(addr, PAGE_BYTES);
+      is.read((char *) lookup(addr, true), PAGE_BYTES);
+    }
+  }
+
+protected:
+  static const unsigned int LEVEL_BITS = 12;
+  unsigned int m_addrBits;
+  unsigned int m_levels;
+  unsigned int m_topBits;
+  void ** m_root;
+  uint64_t m_touchedPages;
+  // one-entry translation cache, the ports mostly access sequentially
+  uint64_t m_lastPageNum;
+  uint8_t * m_lastPage;
+  // pages mapped from a file, not to be freed
+  uint8_t * m_map;
+  uint64_t m_mapBytes;
+
+  static void ** newTable(unsigned int bits) {
+    void ** t = (void **) calloc((size_t) 1 << bits, sizeof(void *));
+    if(!t)
+      throw "SparseMem could not allocate page table";
+    return t;
+  }
+
+  unsigned int levelBits(unsigned int level) const {
+    return (level == 0) ? m_topBits : LEVEL_BITS;
+  }
+
+  void freeTable(void ** t, unsigned int level) {
+    if(level + 1 < m_levels) {
+      for(uint64_t i = 0; i < ((uint64_t) 1 << levelBits(level)); i++)
+        if(t[i]) freeTable((void **) t[i], level + 1);
+    } else {
+      for(uint64_t i = 0; i < ((uint64_t) 1 << levelBits(level)); i++)
+        if(!isMapped(t[i])) free(t[i]);
+    }
+    free(t);
+  }
+
+  bool isMapped(void * page) const {
+    return m_map && (uint8_t *) page >= m_map && (uint8_t *) page < m_map + m_mapBytes;
+  }
+
+  void unmap() {
+    if(m_map) munmap(m_map, m_mapBytes);
+    m_map = 0;
+    m_mapBytes = 0;
+  }
+
+  // page addresses in ascending order
+  void listPages(void ** t, unsigned int level, uint64_t prefix, std::vector<uint64_t> & pages) {
+    for(uint64_t i = 0; i < ((uint64_t) 1 << levelBits(level)); i++) {
+      if(!t[i]) continue;
+      uint64_t pn = (prefix << levelBits(level)) | i;
+      if(level + 1 < m_levels) listPages((void **) t[i], level + 1, pn, pages);
+      else pages.push_back(pn << PAGE_BITS);
+    }
+  }
+
+  void checkRange(uint64_t addr, uint64_t numBytes) {
+    if(numBytes > size() || addr > size() - numBytes)
+      throw "Emulated memory access out of range";
+  }
+
+  // returns the page holding addr, 0 if untouched and !allocate. addresses
+  // beyond the address width wrap around, like on the real address lines.
+  uint8_t * lookup(uint64_t addr, bool allocate) {
+    uint64_t pn = (addr & (size() - 1)) >> PAGE_BITS;
+    if(pn == m_lastPageNum) return m_lastPage;
+    void ** t = m_root;
+    unsigned int shift = (m_levels - 1) * LEVEL_BITS;
+    for(unsigned int level = 0; level < m_levels; level++) {
+      uint64_t ind = (pn >> shift) & (((uint64_t) 1 << levelBits(level)) - 1);
+      if(!t[ind]) {
+        if(!allocate) return 0;
+        if(level + 1 < m_levels) {
+          t[ind] = newTable(LEVEL_BITS);
+        } else {
+          t[ind] = calloc(PAGE_BYTES, 1);
+          if(!t[ind])
+            throw "SparseMem could not allocate page";
+          m_touchedPages++;
+        }
+      }
+      if(level + 1 < m_levels) t = (void **) t[ind];
+      else {
+        m_lastPageNum = pn;
+        m_lastPage = (uint8_t *) t[ind];
+        return m_lastPage;
+      }
+      shift -= LEVEL_BITS;
+    }
+    return 0;
+  }
+
+  // put an existing page at addr, which must not have a page yet
+  void insertPage(uint64_t addr, uint8_t * page) {
+    checkRange(addr, PAGE_BYTES);
+    if(addr & (PAGE_BYTES - 1))
+      throw "SparseMem page address not aligned";
+    uint64_t pn = addr >> PAGE_BITS;
+    void ** t = m_root;
+    unsigned int shift = (m_levels - 1) * LEVEL_BITS;
+    for(unsigned int level = 0; level + 1 < m_levels; level++) {
+      uint64_t ind = (pn >> shift) & (((uint64_t) 1 << levelBits(level)) - 1);
+      if(!t[ind]) t[ind] = newTable(LEVEL_BITS);
+      t = (void **) t[ind];
+      shift -= LEVEL_BITS;
+    }
+    uint64_t ind = pn & (((uint64_t) 1 << levelBits(m_levels - 1)) - 1);
+    if(t[ind])
+      throw "SparseMem page mapped twice";
+    t[ind] = page;
+    m_touchedPages++;
+    m_lastPageNum = ~(uint64_t) 0;
+  }
+
+private:
+  // owns the pages, no copies
+  SparseMem(const SparseMem &);
+  SparseMem & operator=(const SparseMem &);
+};
+
+#endif // SPARSEMEM_HPP
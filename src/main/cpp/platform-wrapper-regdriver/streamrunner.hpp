@@ -0,0 +1,112 @@
+#ifndef STREAMRUNNER_HPP
+#define STREAMRUNNER_HPP
+
+// chunked, double-buffered execution of a job over a host input (and
+// optionally a host output of the same size) that may be larger than the
+// accelerator memory. each chunk is copied into one of two accel buffers and
+// handed to a user callback, which programs the accelerator registers for
+// the chunk, starts it and waits for completion. if the platform supports
+// concurrent copies, the input of chunk N+1 is copied in and the output of
+// chunk N-1 is copied out while chunk N is being processed.
+
+#include <stdint.h>
+#include <functional>
+#include <future>
+#include "wrapperregdriver.h"
+
+class StreamRunner {
+public:
+  // accelIn/accelOut are the accel buffers for this chunk (accelOut is 0 if
+  // there is no output stream), numBytes the chunk size
+  typedef std::function<void(void * accelIn, void * accelOut, uint64_t numBytes, uint64_t chunkInd)> ChunkFxn;
+
+  StreamRunner(WrapperRegDriver * platform, uint64_t chunkBytes) {
+    if(chunkBytes == 0)
+      throw "StreamRunner chunk size must be nonzero";
+    m_platform = platform;
+    m_chunkBytes = chunkBytes;
+    m_overlap = platform->supportsConcurrentCopy();
+    for(unsigned int i = 0; i < 2; i++)
+      m_inBuf[i] = m_outBuf[i] = 0;
+  }
+
+  ~StreamRunner() {
+    for(unsigned int i = 0; i < 2; i++) {
+      if(m_inBuf[i]) m_platform->deallocAccelBuffer(m_inBuf[i]);
+      if(m_outBuf[i]) m_platform->deallocAccelBuffer(m_outBuf[i]);
+    }
+  }
+
+  // hostOut may be 0 for jobs without an output stream
+  void run(const void * hostIn, void * hostOut, uint64_t numBytes, ChunkFxn process) {
+    m_hostIn = (const uint8_t *) hostIn;
+    m_hostOut = (uint8_t *) hostOut;
+    m_numBytes = numBytes;
+    uint64_t numChunks = (numBytes + m_chunkBytes - 1) / m_chunkBytes;
+    if(numChunks == 0) return;
+    allocBuffers(hostOut != 0);
+
+    copyIn(0);
+    for(uint64_t c = 0; c < numChunks; c++) {
+      unsigned int b = c % 2;
+      // transfers for the neighbouring chunks use the other buffer pair
+      std::future<void> transfers;
+      if(m_overlap)
+        transfers = std::async(std::launch::async, &StreamRunner::neighbourTransfers, this, c, numChunks);
+      process(m_inBuf[b], m_outBuf[b], chunkSize(c), c);
+      if(m_overlap) transfers.get();
+      else neighbourTransfers(c, numChunks);
+    }
+    copyOut(numChunks - 1);
+  }
+
+  uint64_t getChunkBytes() { return m_chunkBytes; }
+  // disable to serialize transfers and processing (e.g. for debugging)
+  void setOverlap(bool overlap) { m_overlap = overlap && m_platform->supportsConcurrentCopy(); }
+  bool getOverlap() { return m_overlap; }
+
+protected:
+  WrapperRegDriver * m_platform;
+  uint64_t m_chunkBytes;
+  bool m_overlap;
+  void * m_inBuf[2];
+  void * m_outBuf[2];
+  // current job
+  const uint8_t * m_hostIn;
+  uint8_t * m_hostOut;
+  uint64_t m_numBytes;
+
+  void allocBuffers(bool withOutput) {
+    for(unsigned int i = 0; i < 2; i++) {
+      if(!m_inBuf[i]) m_inBuf[i] = m_platform->allocAccelBuffer(m_chunkBytes);
+      if(withOutput && !m_outBuf[i]) m_outBuf[i] = m_platform->allocAccelBuffer(m_chunkBytes);
+    }
+  }
+
+  uint64_t chunkSize(uint64_t c) {
+    uint64_t begin = c * m_chunkBytes;
+    return (m_numBytes - begin < m_chunkBytes) ? m_numBytes - begin : m_chunkBytes;
+  }
+
+  void copyIn(uint64_t c) {
+    m_platform->copyBufferHostToAccel((void *) (m_hostIn + c * m_chunkBytes), m_inBuf[c % 2], chunkSize(c));
+  }
+
+  void copyOut(uint64_t c) {
+    if(m_hostOut)
+      m_platform->copyBufferAccelToHost(m_outBuf[c % 2], m_hostOut + c * m_chunkBytes, chunkSize(c));
+  }
+
+  // drain the output of the previous chunk, fill the input of the next one
+  void neighbourTransfers(uint64_t c, uint64_t numChunks) {
+    if(c > 0) copyOut(c - 1);
+    if(c + 1 < numChunks) copyIn(c + 1);
+  }
+
+private:
+  // owns accel buffers, no copies
+  StreamRunner(const StreamRunner &);
+  StreamRunner & operator=(const StreamRunner &);
+};
+
+#endif // STREAMRUNNER_HPP
@@ -0,0 +1,97 @@
+#ifndef SWEEPRUNNER_HPP
+#define SWEEPRUNNER_HPP
+
+// runs a set of independent jobs (e.g. the points of a parameter sweep) in
+// parallel, each host thread with its own driver instance from the given
+// factory. meant for the emulator drivers, where every TesterRegDriver has
+// its own accelerator model, memory and allocator, so that a sweep uses all
+// cores instead of simulating one accelerator at a time:
+//
+//   SweepRunner<uint64_t> sweep([]() { return new TesterRegDriver(); });
+//   vector<uint64_t> cycles = sweep.run(numPoints, runPoint);
+//
+// a driver instance is reused for all jobs on its thread. jobs normally
+// construct the generated accelerator driver, which attaches (and so resets)
+// a fresh model and detaches it again when going out of scope.
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include "wrapperregdriver.h"
+
+template <class Result>
+class SweepRunner {
+public:
+  typedef std::function<WrapperRegDriver *()> DriverFactory;
+  typedef std::function<Result(WrapperRegDriver * platform, unsigned int jobInd)> JobFxn;
+
+  // numThreads = 0 uses one thread per hardware thread
+  SweepRunner(DriverFactory factory, unsigned int numThreads = 0) {
+    m_factory = factory;
+    if(numThreads == 0) numThreads = std::thread::hardware_concurrency();
+    if(numThreads == 0) numThreads = 1;
+    m_numThreads = numThreads;
+  }
+
+  // runs job(platform, i) for i in [0, numJobs) and returns the results in
+  // job order. if any jobs throw, the first exception is rethrown after all
+  // other jobs are done.
+  std::vector<Result> run(unsigned int numJobs, JobFxn job) {
+    m_results.assign(numJobs, Result());
+    m_nextJob = 0;
+    m_numJobs = numJobs;
+    m_job = job;
+    m_error = std::exception_ptr();
+    std::vector<std::thread> threads;
+    unsigned int numThreads = (numJobs < m_numThreads) ? numJobs : m_numThreads;
+    for(unsigned int i = 0; i < numThreads; i++)
+      threads.push_back(std::thread(&SweepRunner::worker, this));
+    for(unsigned int i = 0; i < threads.size(); i++)
+      threads[i].join();
+    if(m_error)
+      std::rethrow_exception(m_error);
+    return m_results;
+  }
+
+  unsigned int getNumThreads() { return m_numThreads; }
+
+protected:
+  DriverFactory m_factory;
+  unsigned int m_numThreads;
+  // current sweep
+  std::mutex m_mutex;
+  unsigned int m_nextJob;
+  unsigned int m_numJobs;
+  JobFxn m_job;
+  std::vector<Result> m_results;
+  std::exception_ptr m_error;
+
+  // returns false when there are no jobs left
+  bool nextJob(unsigned int & jobInd) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_nextJob >= m_numJobs) return false;
+    jobInd = m_nextJob++;
+    return true;
+  }
+
+  void worker() {
+    WrapperRegDriver * platform = 0;
+    unsigned int jobInd;
+    while(nextJob(jobInd)) {
+      try {
+        if(!platform) platform = m_factory();
+        Result res = m_job(platform, jobInd);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results[jobInd] = res;
+      } catch(...) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if(!m_error) m_error = std::current_exception();
+      }
+    }
+    delete platform;
+  }
+};
+
+#endif // SWEEPRUNNER_HPP
@@ -5,7 +5,20 @@
 #include <string.h>
 using namespace std;
 #include "wrapperregdriver.h"
+#include "bufferallocator.hpp"
+#include "checkpoint.hpp"
+#include "emumemmodel.hpp"
+#include "sparsemem.hpp"
 #include "TesterWrapper.h"
+#include "TesterMemPorts.h"
+#include <fstream>
+#include <vector>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/eventfd.h>
 
 // enable verbose reg read/writes and Chisel HW printfs
 // remember to compile with -std=c++11 for Chisel HW printfs to work
@@ -22,6 +35,29 @@ using namespace std;
 #define __TESTERDRIVER_DEBUG(x) (0)
 #endif
 
+// memory port hooks, expanded for each port in TESTER_MEM_PORTS. before the
+// clock edge, supply the read data and let the timing model stall the ports.
+// after it, the outputs still hold the values from before the edge: do the
+// writes and tell the timing model which requests and beats went through.
+#define __TESTER_MEM_IN(i) \
+  m_inst->TesterWrapper__io_memData_##i##_rdData = m_mem->read64(m_inst->TesterWrapper__io_memData_##i##_rdAddr.to_ulong()); \
+  m_inst->TesterWrapper__io_memTiming_##i##_rdStall = m_memModel ? m_memModel->readStall(i) : 0; \
+  m_inst->TesterWrapper__io_memTiming_##i##_wrStall = m_memModel ? m_memModel->writeStall(i) : 0;
+#define __TESTER_MEM_OUT(i) \
+  if(m_inst->TesterWrapper__io_memData_##i##_wrEn.to_ulong()) \
+    m_mem->write64(m_inst->TesterWrapper__io_memData_##i##_wrAddr.to_ulong(), \
+      m_inst->TesterWrapper__io_memData_##i##_wrData.to_ulong()); \
+  if(m_memModel) { \
+    if(m_inst->TesterWrapper__io_memTiming_##i##_rdReqFire.to_ulong()) \
+      m_memModel->readRequest(i, m_inst->TesterWrapper__io_memTiming_##i##_rdReqAddr.to_ulong(), \
+        m_inst->TesterWrapper__io_memTiming_##i##_rdReqBytes.to_ulong()); \
+    if(m_inst->TesterWrapper__io_memTiming_##i##_wrReqFire.to_ulong()) \
+      m_memModel->writeRequest(i, m_inst->TesterWrapper__io_memTiming_##i##_wrReqAddr.to_ulong(), \
+        m_inst->TesterWrapper__io_memTiming_##i##_wrReqBytes.to_ulong()); \
+    if(m_inst->TesterWrapper__io_memTiming_##i##_rdBeatFire.to_ulong()) m_memModel->readBeat(i); \
+    if(m_inst->TesterWrapper__io_memTiming_##i##_wrBeatFire.to_ulong()) m_memModel->writeBeat(i); \
+  }
+
 // register driver for the Tester platform, using the Chisel-generated C++ model to
 // interface with the accelerator model
 // note that TesterWrapper.h must be generated for each new accelerator, it is the
@@ -29,15 +65,41 @@ using namespace std;
 
 class TesterRegDriver : public WrapperRegDriver {
 public:
-  TesterRegDriver() {m_inst = 0; m_freePtr = 0;}
+  // each instance has its own model, memory and allocator, so several
+  // instances can be used in parallel from different threads
+  TesterRegDriver() {
+    m_inst = 0; m_mem = 0; m_allocator = 0; m_chargeCopyCycles = false; m_lastWaitCycles = 0; m_cycle = 0;
+    m_memModel = 0; m_memModelOn = false;
+    m_irqLevel = false; m_hasIrqReg = false; m_irqReg = 0;
+    m_irqFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(m_irqFd < 0)
+      throw "Could not create interrupt eventfd";
+    // EMU_MEM_MODEL selects a memory model preset without recompiling
+    const char * envMem = getenv("EMU_MEM_MODEL");
+    if(envMem) setMemModel(EmuMemModel::preset(envMem));
+  }
+
+  virtual ~TesterRegDriver() {
+    detach();
+    close(m_irqFd);
+  }
 
+  // attaching again without detaching first drops the previous model and
+  // all its buffers
   virtual void attach(const char * name) {
+    detach();
     m_inst = new TesterWrapper_t();
-    // get # words in the memory
-    m_memWords = m_inst->TesterWrapper__mem.length();
+    m_cycle = 0;
+    // main memory covers the accelerator's whole address space, but only
+    // takes up host memory for the pages actually used
+    m_mem = new SparseMem(TESTER_MEM_ADDR_BITS);
+    m_allocator = new BufferAllocator(0, m_mem->size());
     // initialize and reset the model
     m_inst->init();
+    TESTER_MEM_PORTS(__TESTER_MEM_IN)
     reset();
+    m_irqLevel = false;
+    if(m_memModelOn) m_memModel = new EmuMemModel(m_memParams, TESTER_NUM_MEM_PORTS);
     m_regCount = m_inst->TesterWrapper__io_regFileIF_regCount.to_ulong();
   }
 
@@ -46,65 +108,76 @@ public:
       delete m_inst;
       m_inst = 0;
     }
+    if(m_allocator) {
+      delete m_allocator;
+      m_allocator = 0;
+    }
+    delete m_mem;
+    m_mem = 0;
+    delete m_memModel;
+    m_memModel = 0;
   }
 
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    __TESTERDRIVER_DEBUG_PRINT("host2accel(" << (uint64_t) hostBuffer << " -> " << accelBufBase << " : " << numBytes << " bytes)");
-
-    if((numBytes % 8 == 0) && (accelBufBase % 8 == 0))
-      alignedCopyBufferHostToAccel(hostBuffer, accelBuffer, numBytes);
-    else {
-      // align base and size
-      uint64_t alignedBase = accelBufBase - (accelBufBase % 8);
-      uint64_t startDiff = accelBufBase - alignedBase;
-      unsigned int alignedSize = (startDiff + numBytes + 7) / 8 * 8;
-      // copy containing block into host memory
-      char * tmp = new char[alignedSize];
-      alignedCopyBufferAccelToHost((void *)alignedBase, (void *) tmp, alignedSize);
-      // do host-to-host unaligned copy
-      memcpy((void *)&tmp[startDiff], hostBuffer, numBytes);
-      // write containing block back to accel memory
-      alignedCopyBufferHostToAccel((void *)tmp, (void *)alignedBase, alignedSize);
-      delete [] tmp;
-    }
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
+    __TESTERDRIVER_DEBUG_PRINT("host2accel(" << (uint64_t) hostBuffer << " -> " << (uint64_t) accelBuffer << " : " << numBytes << " bytes)");
+    m_mem->write((uint64_t) accelBuffer, hostBuffer, numBytes);
+    if(m_chargeCopyCycles) step((numBytes + 7) / 8);
   }
 
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    __TESTERDRIVER_DEBUG_PRINT("accel2host(" << accelBufBase << " -> " << (uint64_t) hostBuffer << " : " << numBytes << " bytes)");
-
-    if((numBytes % 8 == 0) && (accelBufBase % 8 == 0))
-      alignedCopyBufferAccelToHost(accelBuffer, hostBuffer, numBytes);
-    else {
-      // implement unaligned accel-to-host
-      // align base and size
-      uint64_t alignedBase = accelBufBase - (accelBufBase % 8);
-      uint64_t startDiff = accelBufBase - alignedBase;
-      unsigned int alignedSize = (startDiff + numBytes + 7) / 8 * 8;
-      // copy containing block into host memory
-      char * tmp = new char[alignedSize];
-      alignedCopyBufferAccelToHost((void *)alignedBase, (void *) tmp, alignedSize);
-      // do host-to-host unaligned copy
-      memcpy(hostBuffer, (void *)&tmp[startDiff],numBytes);
-      delete [] tmp;
-    }
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
+    __TESTERDRIVER_DEBUG_PRINT("accel2host(" << (uint64_t) accelBuffer << " -> " << (uint64_t) hostBuffer << " : " << numBytes << " bytes)");
+    m_mem->read((uint64_t) accelBuffer, hostBuffer, numBytes);
+    if(m_chargeCopyCycles) step((numBytes + 7) / 8);
   }
 
-  virtual void * allocAccelBuffer(unsigned int numBytes) {
-    // all this assumes allocation and mem word size of 64 bytes
-    // round requested size to nearest multiple of 64
-    unsigned int actualAllocSize = (numBytes + 63) / 64 * 64;
-    void * accelBuf = (void *) m_freePtr;
-    // update free pointer and sanity check
-    m_freePtr += actualAllocSize;
-    if(m_freePtr > m_memWords * 8)
-      throw "Not enough memory in allocAccelBuffer";
-    __TESTERDRIVER_DEBUG_PRINT("allocAccelBuffer(" << numBytes << ", alloc " << actualAllocSize <<") = " << (uint64_t) accelBuf);
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
+    // buffers are 64-byte aligned, which also satisfies the mem word size
+    void * accelBuf = (void *) m_allocator->alloc(numBytes);
+    __TESTERDRIVER_DEBUG_PRINT("allocAccelBuffer(" << numBytes << ", alloc " << m_allocator->allocSize((uint64_t) accelBuf) <<") = " << (uint64_t) accelBuf);
 
     return accelBuf;
   }
 
+  virtual void deallocAccelBuffer(void * buffer) {
+    __TESTERDRIVER_DEBUG_PRINT("deallocAccelBuffer(" << (uint64_t) buffer << ")");
+    m_allocator->dealloc((uint64_t) buffer);
+  }
+
+  const BufferAllocator & getAllocator() { return *m_allocator; }
+
+  // host-accel buffer copies go straight into the main memory, without
+  // clocking the model. enable this to charge the copies in idle cycles:
+  // after each copy, the clock runs for one cycle per 8 bytes copied, about
+  // what the copies through the old testbench memory port took. the data is
+  // still written instantly and does not go through the memory ports, so
+  // this only shifts the cycle counts, it does not model contention.
+  void setChargeCopyCycles(bool enable) {m_chargeCopyCycles = enable;}
+
+  // number of main memory pages that have been written to
+  uint64_t getTouchedPages() {return m_mem ? m_mem->getTouchedPages() : 0;}
+
+  // DRAM timing model for the accelerator memory ports, see emumemmodel.hpp.
+  // the model state starts out idle on every attach.
+  void setMemModel(const EmuMemParams & p) {
+    EmuMemModel::checkParams(p);
+    m_memParams = p;
+    m_memModelOn = true;
+    if(m_inst) {
+      delete m_memModel;
+      m_memModel = new EmuMemModel(m_memParams, TESTER_NUM_MEM_PORTS);
+    }
+  }
+
+  void clearMemModel() {
+    m_memModelOn = false;
+    delete m_memModel;
+    m_memModel = 0;
+    if(m_inst) {TESTER_MEM_PORTS(__TESTER_MEM_IN)}
+  }
+
+  // for the model statistics, 0 if there is no model
+  EmuMemModel * getMemModel() {return m_memModel;}
+
   // register access methods for the platform wrapper
   virtual void writeReg(unsigned int regInd, AccelReg regValue) {
     __TESTERDRIVER_DEBUG_PRINT("writeReg(" << regInd << ", " << regValue  << ") ");
@@ -142,6 +215,209 @@ public:
     return ret;
   }
 
+  // batched register access: commands are issued back-to-back, one cycle
+  // each, with a single completion delay at the end of the batch
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_write = 1;
+    m_inst->TesterWrapper__io_regFileIF_cmd_valid = 1;
+    for(unsigned int i = 0; i < numRegs; i++) {
+      __TESTERDRIVER_DEBUG_PRINT("writeRegs(" << regInds[i] << ", " << regValues[i]  << ") ");
+      m_inst->TesterWrapper__io_regFileIF_cmd_bits_writeData = regValues[i];
+      m_inst->TesterWrapper__io_regFileIF_cmd_bits_regID = regInds[i];
+      step();
+    }
+    m_inst->TesterWrapper__io_regFileIF_cmd_valid = 0;
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_write = 0;
+    step(5);
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_read = 1;
+    m_inst->TesterWrapper__io_regFileIF_cmd_valid = 1;
+    for(unsigned int i = 0; i < numRegs; i++) {
+      m_inst->TesterWrapper__io_regFileIF_cmd_bits_regID = regInds[i];
+      step();
+      if(!m_inst->TesterWrapper__io_regFileIF_readData_valid.to_bool())
+        throw "Could not read register";
+      regValues[i] = m_inst->TesterWrapper__io_regFileIF_readData_bits.to_ulong();
+      __TESTERDRIVER_DEBUG_PRINT("readRegs(" << regInds[i] << ") = " << regValues[i]);
+    }
+    m_inst->TesterWrapper__io_regFileIF_cmd_valid = 0;
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_read = 0;
+    step(5);
+  }
+
+  // run the clock until the register holds the expected value. a read
+  // command is kept asserted throughout, so the register file returns the
+  // current value every cycle without any further register accesses
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    uint64_t start = timestampUs();
+    bool done = false;
+    m_lastWaitCycles = 0;
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_regID = regInd;
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_read = 1;
+    m_inst->TesterWrapper__io_regFileIF_cmd_valid = 1;
+    while(!done) {
+      step();
+      m_lastWaitCycles++;
+      done = m_inst->TesterWrapper__io_regFileIF_readData_valid.to_bool() && ((AccelReg) m_inst->TesterWrapper__io_regFileIF_readData_bits.to_ulong() == expValue);
+      // only check the host clock once in a while, it costs more than a cycle
+      if(!done && timeoutUs != 0 && (m_lastWaitCycles % 1024 == 0))
+        if(timestampUs() - start >= timeoutUs) break;
+    }
+    m_inst->TesterWrapper__io_regFileIF_cmd_valid = 0;
+    m_inst->TesterWrapper__io_regFileIF_cmd_bits_read = 0;
+    // the wait consumed the completion event, as on the UIO platforms
+    if(done && m_hasIrqReg && regInd == m_irqReg) clearInterrupt();
+    m_lastWaitUs = timestampUs() - start;
+    __TESTERDRIVER_DEBUG_PRINT("waitForCompletion(" << regInd << ", " << expValue << ") = " << done << " after " << m_lastWaitCycles << " cycles");
+    return done;
+  }
+
+  // stand-in for the completion interrupt of the real platforms: an eventfd
+  // that is signalled whenever the model's irq output rises. the model only
+  // runs inside driver calls, so the fd becomes readable during
+  // waitForCompletion or other register accesses, not in the background.
+  virtual void setInterruptReg(unsigned int regInd) {
+    m_irqReg = regInd;
+    m_hasIrqReg = true;
+  }
+
+  virtual int getInterruptFd() {return m_irqFd;}
+
+  virtual void clearInterrupt() {
+    uint64_t count;
+    // nothing to read if the interrupt has not fired
+    if(read(m_irqFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+      throw "Could not read interrupt eventfd";
+  }
+
+  // number of clock cycles run by the last waitForCompletion call
+  uint64_t getLastWaitCycles() {return m_lastWaitCycles;}
+
+  // clock cycles since attach (or as restored from a checkpoint)
+  uint64_t getCycleCount() {return m_cycle;}
+
+  // checkpointing: the model object, including all accelerator memories
+  // (which Chisel stores inline), is saved as a raw page-aligned image together
+  // with the allocator layout and optional application data (e.g. buffer
+  // addresses), followed by the touched main memory pages and the memory
+  // timing model state. restoring maps the image and the memory pages
+  // copy-on-write: the image is copied into the attached model, but the
+  // memory pages are only read in as the accelerator touches them, so any
+  // number of runs can start quickly from one warm checkpoint without
+  // redoing the reset, data loading and warm-up. a raw image is only
+  // meaningful to the exact same model build, so checkpoints carry the build
+  // fingerprint from TesterMemPorts.h and are rejected by any other build.
+  void saveCheckpoint(const char * fileName, const void * userData = 0, uint64_t userBytes = 0) {
+    checkImageable();
+    CheckpointHeader hdr;
+    hdr.kind = CHECKPOINT_KIND_CHISEL;
+    hdr.modelBytes = sizeof(TesterWrapper_t);
+    hdr.fingerprint = TESTER_MODEL_FINGERPRINT;
+    hdr.cycle = m_cycle;
+    saveIrqState(hdr);
+    hdr.hasMemModel = (m_memModel != 0);
+    std::vector<uint64_t> pages = m_mem->getPageList();
+    hdr.memPages = pages.size();
+    std::string meta = CheckpointMeta::serialize(hdr, *m_allocator, userData, userBytes);
+    // the image and the page data start on page boundaries, to be mapped
+    uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    uint64_t imageOffset = (meta.size() + pageSize - 1) / pageSize * pageSize;
+    uint64_t listEnd = imageOffset + sizeof(TesterWrapper_t) + pages.size() * sizeof(uint64_t);
+    uint64_t memOffset = (listEnd + pageSize - 1) / pageSize * pageSize;
+    ((CheckpointHeader *) &meta[0])->imageOffset = imageOffset;
+    ((CheckpointHeader *) &meta[0])->memOffset = memOffset;
+    meta.resize(imageOffset, '\0');
+    ofstream out(fileName, ios::binary | ios::trunc);
+    out.write(meta.data(), meta.size());
+    out.write((const char *) m_inst, sizeof(TesterWrapper_t));
+    if(!pages.empty()) out.write((const char *) &pages[0], pages.size() * sizeof(uint64_t));
+    std::string pad(memOffset - listEnd, '\0');
+    out.write(pad.data(), pad.size());
+    m_mem->savePages(out, pages);
+    if(m_memModel) m_memModel->save(out);
+    if(!out)
+      throw "Could not write checkpoint file";
+  }
+
+  // the model must be attached, from the same build, and use the same
+  // memory model as when the checkpoint was saved. if anything does not
+  // match, this throws and the driver state is unchanged.
+  void restoreCheckpoint(const char * fileName, void * userData = 0, uint64_t userBytes = 0) {
+    checkImageable();
+    CheckpointHeader hdr;
+    std::string user;
+    BufferAllocator * allocator = new BufferAllocator(0, m_mem->size());
+    SparseMem * mem = new SparseMem(TESTER_MEM_ADDR_BITS);
+    EmuMemModel * memModel = 0;
+    void * image = MAP_FAILED;
+    try {
+      uint64_t fileBytes = CheckpointMeta::fileSize(fileName);
+      std::vector<uint64_t> pages;
+      {
+        ifstream in(fileName, ios::binary);
+        if(!in)
+          throw "Could not open checkpoint file";
+        CheckpointMeta::deserialize(in, fileBytes, hdr, CHECKPOINT_KIND_CHISEL, sizeof(TesterWrapper_t),
+          TESTER_MODEL_FINGERPRINT, *allocator, user);
+        if((hdr.hasMemModel != 0) != (m_memModel != 0))
+          throw "Checkpoint was saved with a different memory model";
+        uint64_t listOffset = hdr.imageOffset + sizeof(TesterWrapper_t);
+        uint64_t memBytes = hdr.memPages * SparseMem::PAGE_BYTES;
+        if(hdr.imageOffset > fileBytes || hdr.memOffset < listOffset + hdr.memPages * sizeof(uint64_t) ||
+          hdr.memOffset > fileBytes || memBytes > fileBytes - hdr.memOffset)
+          throw "Checkpoint file truncated";
+        pages.resize(hdr.memPages);
+        in.seekg(listOffset);
+        if(!pages.empty()) in.read((char *) &pages[0], pages.size() * sizeof(uint64_t));
+        if(m_memModel) {
+          memModel = new EmuMemModel(m_memParams, TESTER_NUM_MEM_PORTS);
+          in.seekg(hdr.memOffset + memBytes);
+          memModel->restore(in);
+        }
+        if(!in)
+          throw "Checkpoint file truncated";
+      }
+      int fd = open(fileName, O_RDONLY);
+      if(fd < 0)
+        throw "Could not open checkpoint file";
+      image = mmap(NULL, sizeof(TesterWrapper_t), PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, (off_t) hdr.imageOffset);
+      void * memMap = 0;
+      uint64_t memBytes = hdr.memPages * SparseMem::PAGE_BYTES;
+      if(image != MAP_FAILED && memBytes > 0)
+        memMap = mmap(NULL, memBytes, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, (off_t) hdr.memOffset);
+      close(fd);
+      if(image == MAP_FAILED || memMap == MAP_FAILED)
+        throw "Could not map checkpoint image";
+      if(memMap) mem->mapPages(pages, memMap, memBytes);
+      // the saved vtable pointer belongs to the process that wrote the image,
+      // set_circuit_from needs a valid one to check the source type. the
+      // fingerprint check above makes sure it is the same class.
+      memcpy(image, (void *) m_inst, sizeof(void *));
+      // set_circuit_from checks the type before it copies anything, so it
+      // can go first and the rest cannot fail anymore
+      if(!m_inst->set_circuit_from((mod_t *) image))
+        throw "Could not restore model state from checkpoint";
+    } catch(...) {
+      if(image != MAP_FAILED) munmap(image, sizeof(TesterWrapper_t));
+      delete allocator;
+      delete mem;
+      delete memModel;
+      throw;
+    }
+    munmap(image, sizeof(TesterWrapper_t));
+    delete m_allocator;
+    m_allocator = allocator;
+    delete m_mem;
+    m_mem = mem;
+    delete m_memModel;
+    m_memModel = memModel;
+    m_cycle = hdr.cycle;
+    CheckpointMeta::copyUserData(user, userData, userBytes);
+    restoreIrqState(hdr);
+  }
+
   void printAllRegs() {
     for(unsigned int i = 0; i < m_regCount; i++)  {
         AccelReg val = readReg(i);
@@ -152,9 +428,55 @@ public:
 
 protected:
   TesterWrapper_t * m_inst;
-  unsigned int m_memWords;
+  SparseMem * m_mem;
   unsigned int m_regCount;
-  uint64_t m_freePtr;
+  BufferAllocator * m_allocator;
+  bool m_chargeCopyCycles;
+  uint64_t m_lastWaitCycles;
+  uint64_t m_cycle;
+  EmuMemModel * m_memModel;
+  EmuMemParams m_memParams;
+  bool m_memModelOn;
+  // completion interrupt stand-in
+  int m_irqFd;
+  bool m_irqLevel;
+  bool m_hasIrqReg;
+  unsigned int m_irqReg;
+
+  // the irq level and an unconsumed event, for checkpoints
+  void saveIrqState(CheckpointHeader & hdr) {
+    uint64_t count = 0;
+    hdr.irqLevel = m_irqLevel;
+    hdr.irqPending = (read(m_irqFd, &count, sizeof(count)) == sizeof(count));
+    // put the event back, saving must not consume it
+    if(hdr.irqPending && write(m_irqFd, &count, sizeof(count)) != sizeof(count))
+      throw "Could not signal interrupt eventfd";
+  }
+
+  void restoreIrqState(const CheckpointHeader & hdr) {
+    clearInterrupt();
+    m_irqLevel = (hdr.irqLevel != 0);
+    uint64_t one = 1;
+    if(hdr.irqPending && write(m_irqFd, &one, sizeof(one)) != sizeof(one))
+      throw "Could not signal interrupt eventfd";
+  }
+
+  void updateIrq(bool level) {
+    if(level && !m_irqLevel) {
+      uint64_t one = 1;
+      if(write(m_irqFd, &one, sizeof(one)) != sizeof(one))
+        throw "Could not signal interrupt eventfd";
+    }
+    m_irqLevel = level;
+  }
+
+  // raw model images assume that the model stores all its memories inline,
+  // as the Chisel versions with mem_t arrays do. this cannot be checked
+  // here, only that a model is attached.
+  void checkImageable() {
+    if(!m_inst)
+      throw "Checkpointing needs an attached model";
+  }
 
   void reset() {
     m_inst->clock(1);
@@ -163,44 +485,21 @@ protected:
     m_inst->clock_lo(0);
   }
 
-  void step(int n = 1) {
-    for(int i = 0; i < n; i++) {
+  // 64-bit count, copies charged in cycles can be larger than 2^31 words
+  void step(uint64_t n = 1) {
+    for(uint64_t i = 0; i < n; i++) {
+      if(m_memModel) m_memModel->beginCycle();
+      TESTER_MEM_PORTS(__TESTER_MEM_IN)
       m_inst->clock(0);
+      TESTER_MEM_PORTS(__TESTER_MEM_OUT)
+      if(m_memModel) m_memModel->endCycle();
       // Chisel c++ backend requires this workaround to get out the correct values
       m_inst->clock_lo(0);
+      m_cycle++;
+      updateIrq(m_inst->TesterWrapper__io_irq.to_bool());
       __TESTERDRIVER_DEBUG(m_inst->print(cout));
     }
   }
-
-  void memWrite(uint64_t addr, uint64_t value) {
-    m_inst->TesterWrapper__io_memAddr = addr;
-    m_inst->TesterWrapper__io_memWriteData = value;
-    m_inst->TesterWrapper__io_memWriteEn = 1;
-    step();
-    m_inst->TesterWrapper__io_memWriteEn = 0;
-  }
-
-  uint64_t memRead(uint64_t addr) {
-    m_inst->TesterWrapper__io_memAddr = addr;
-    step();
-    uint64_t ret = m_inst->TesterWrapper__io_memReadData[0];
-    return ret;
-  }
-
-  // "aligned" copy functions, where accel ptr start and size are guaranteed to be 8-aligned
-  void alignedCopyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
-    uint64_t * host_buf = (uint64_t *) hostBuffer;
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    for(unsigned int i = 0; i < numBytes/8; i++)
-        memWrite(accelBufBase + i*8, host_buf[i]);
-  }
-
-  void alignedCopyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    uint64_t * readBuf = (uint64_t *) hostBuffer;
-    for(unsigned int i = 0; i < numBytes/8; i++)
-      readBuf[i] = memRead(accelBufBase + i*8);
-  }
 };
 
 #endif
@@ -0,0 +1,166 @@
+#ifndef THREADSAFEREGDRIVER_HPP
+#define THREADSAFEREGDRIVER_HPP
+
+// decorator that makes any WrapperRegDriver safe to share between host
+// threads. locking is as fine-grained as the wrapped driver allows:
+// - register accesses go straight through if the driver supports concurrent
+//   register access (e.g. memory-mapped AXI registers), otherwise they are
+//   serialized one access (or one batch) at a time
+// - buffer copies use their own lock if the driver supports concurrent
+//   copies, so transfers don't block register accesses
+// - waitForCompletion polls through readReg, so other threads get the driver
+//   between polls instead of being locked out for the whole wait (the
+//   emulator fast path is not used). the exception is the interrupt wait of
+//   drivers with lock-free registers (UIORegDriver), which only reads
+//   registers and sleeps, and is called without a lock. getLastWaitTimeUs
+//   reports the most recent wait of any thread.
+
+#include <mutex>
+#include "wrapperregdriver.h"
+
+class ThreadSafeRegDriver : public WrapperRegDriver {
+public:
+  ThreadSafeRegDriver(WrapperRegDriver * driver) {
+    m_driver = driver;
+    m_lockFreeRegs = driver->supportsConcurrentRegAccess();
+    m_separateCopyLock = driver->supportsConcurrentCopy();
+    m_hasIrqReg = false;
+    m_irqReg = 0;
+  }
+
+  virtual ~ThreadSafeRegDriver() {}
+
+  WrapperRegDriver * getWrappedDriver() { return m_driver; }
+
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    m_driver->copyBufferHostToAccel(hostBuffer, accelBuffer, numBytes);
+  }
+
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    m_driver->copyBufferAccelToHost(accelBuffer, hostBuffer, numBytes);
+  }
+
+  // the buffer allocators are not thread-safe
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    return m_driver->allocAccelBuffer(numBytes);
+  }
+
+  virtual void deallocAccelBuffer(void * buffer) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    m_driver->deallocAccelBuffer(buffer);
+  }
+
+  virtual void * getHostPointer(void * accelBuffer) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    return m_driver->getHostPointer(accelBuffer);
+  }
+
+  virtual void syncBufferForAccel(void * accelBuffer, uint64_t numBytes) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    m_driver->syncBufferForAccel(accelBuffer, numBytes);
+  }
+
+  virtual void syncBufferForHost(void * accelBuffer, uint64_t numBytes) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    m_driver->syncBufferForHost(accelBuffer, numBytes);
+  }
+
+  // forwarded as a whole, so that platform fast paths (e.g. reading the
+  // file straight into the buffer window) are kept
+  virtual uint64_t loadFileToAccel(const char * fileName, void * accelBuffer) {
+    std::lock_guard<std::mutex> lock(copyMutex());
+    return m_driver->loadFileToAccel(fileName, accelBuffer);
+  }
+
+  virtual bool supportsConcurrentCopy() { return true; }
+  virtual bool supportsConcurrentRegAccess() { return true; }
+
+  virtual void attach(const char * name) {
+    std::lock_guard<std::mutex> regLock(m_regMutex);
+    std::lock_guard<std::mutex> copyLock(m_copyMutex);
+    m_driver->attach(name);
+  }
+
+  virtual void detach() {
+    std::lock_guard<std::mutex> regLock(m_regMutex);
+    std::lock_guard<std::mutex> copyLock(m_copyMutex);
+    m_driver->detach();
+  }
+
+  virtual void setVolatileReg(unsigned int regInd) {
+    std::lock_guard<std::mutex> lock(m_regMutex);
+    m_driver->setVolatileReg(regInd);
+  }
+
+  virtual void setInterruptReg(unsigned int regInd) {
+    std::lock_guard<std::mutex> lock(m_regMutex);
+    m_driver->setInterruptReg(regInd);
+    m_irqReg = regInd;
+    m_hasIrqReg = true;
+  }
+
+  virtual int getInterruptFd() { return m_driver->getInterruptFd(); }
+
+  virtual void clearInterrupt() {
+    std::lock_guard<std::mutex> lock(m_regMutex);
+    m_driver->clearInterrupt();
+  }
+
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    if(m_lockFreeRegs && m_hasIrqReg && regInd == m_irqReg && m_driver->getInterruptFd() >= 0) {
+      bool ret = m_driver->waitForCompletion(regInd, expValue, timeoutUs);
+      m_lastWaitUs = m_driver->getLastWaitTimeUs();
+      return ret;
+    }
+    return WrapperRegDriver::waitForCompletion(regInd, expValue, timeoutUs);
+  }
+
+  virtual void writeReg(unsigned int regInd, AccelReg regValue) {
+    if(m_lockFreeRegs) m_driver->writeReg(regInd, regValue);
+    else {
+      std::lock_guard<std::mutex> lock(m_regMutex);
+      m_driver->writeReg(regInd, regValue);
+    }
+  }
+
+  virtual AccelReg readReg(unsigned int regInd) {
+    if(m_lockFreeRegs) return m_driver->readReg(regInd);
+    std::lock_guard<std::mutex> lock(m_regMutex);
+    return m_driver->readReg(regInd);
+  }
+
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    if(m_lockFreeRegs) m_driver->writeRegs(numRegs, regInds, regValues);
+    else {
+      std::lock_guard<std::mutex> lock(m_regMutex);
+      m_driver->writeRegs(numRegs, regInds, regValues);
+    }
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    if(m_lockFreeRegs) m_driver->readRegs(numRegs, regInds, regValues);
+    else {
+      std::lock_guard<std::mutex> lock(m_regMutex);
+      m_driver->readRegs(numRegs, regInds, regValues);
+    }
+  }
+
+protected:
+  WrapperRegDriver * m_driver;
+  bool m_lockFreeRegs;
+  bool m_separateCopyLock;
+  bool m_hasIrqReg;
+  unsigned int m_irqReg;
+  std::mutex m_regMutex;
+  std::mutex m_copyMutex;
+
+  // copies share the register lock unless the driver allows them to overlap
+  std::mutex & copyMutex() {
+    return m_separateCopyLock ? m_copyMutex : m_regMutex;
+  }
+};
+
+#endif // THREADSAFEREGDRIVER_HPP
@@ -0,0 +1,100 @@
+#ifndef UIOREGDRIVER_HPP
+#define UIOREGDRIVER_HPP
+
+// LinuxPhysRegDriver that also receives the accelerator's completion
+// interrupt (the irq output of AXIPlatformWrapper) through a Linux UIO
+// device, so that waiting for a long job sleeps instead of polling the
+// finished register over /dev/mem. the interrupt has to be described in the
+// device tree for the generic UIO driver, e.g.
+//
+//   accel@43c00000 {
+//     compatible = "generic-uio";
+//     reg = <0x43c00000 0x10000>;
+//     interrupt-parent = <&intc>;
+//     interrupts = <0 29 4>;    // level high
+//   };
+//
+// with uio_pdrv_genirq.of_id=generic-uio on the kernel command line. the
+// kernel masks the interrupt each time it fires, it is re-armed before
+// every check of the finished register.
+
+#include <stdint.h>
+#include <poll.h>
+#include <errno.h>
+#include "linuxphysregdriver.hpp"
+
+class UIORegDriver : public LinuxPhysRegDriver {
+public:
+  UIORegDriver(const char * uioDevice, void * baseAddrPhys, void * memBufBasePhys, uint64_t memBufBytes)
+    : LinuxPhysRegDriver(baseAddrPhys, memBufBasePhys, memBufBytes) {
+    m_uioFd = open(uioDevice, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if(m_uioFd < 0)
+      throw "Could not open UIO device";
+    m_hasIrqReg = false;
+    m_irqReg = 0;
+  }
+
+  virtual ~UIORegDriver() {
+    close(m_uioFd);
+  }
+
+  virtual void setInterruptReg(unsigned int regInd) {
+    m_irqReg = regInd;
+    m_hasIrqReg = true;
+  }
+
+  virtual int getInterruptFd() { return m_uioFd; }
+
+  virtual void clearInterrupt() {
+    uint32_t count;
+    // nothing to read if the interrupt has not fired
+    if(read(m_uioFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+      throw "Could not read UIO device";
+    enableInterrupt();
+  }
+
+  // sleeps on the interrupt when waiting for the finished register to
+  // become nonzero, other waits poll as usual
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    if(!m_hasIrqReg || regInd != m_irqReg || expValue == 0)
+      return LinuxPhysRegDriver::waitForCompletion(regInd, expValue, timeoutUs);
+    uint64_t start = timestampUs();
+    bool done = false;
+    while(true) {
+      // re-arm before checking, so that an interrupt raised right after the
+      // check is not missed
+      clearInterrupt();
+      done = (readReg(regInd) == expValue);
+      if(done) break;
+      int waitMs = -1;
+      if(timeoutUs != 0) {
+        uint64_t elapsed = timestampUs() - start;
+        if(elapsed >= timeoutUs) break;
+        waitMs = (int) ((timeoutUs - elapsed + 999) / 1000);
+      }
+      struct pollfd pfd = {m_uioFd, POLLIN, 0};
+      if(poll(&pfd, 1, waitMs) < 0 && errno != EINTR)
+        throw "poll failed on UIO device";
+    }
+    m_lastWaitUs = timestampUs() - start;
+    return done;
+  }
+
+protected:
+  int m_uioFd;
+  bool m_hasIrqReg;
+  unsigned int m_irqReg;
+
+  void enableInterrupt() {
+    uint32_t one = 1;
+    if(write(m_uioFd, &one, sizeof(one)) != sizeof(one))
+      throw "Could not enable UIO interrupt";
+  }
+
+private:
+  // owns the UIO file descriptor, no copies
+  UIORegDriver(const UIORegDriver &);
+  UIORegDriver & operator=(const UIORegDriver &);
+};
+
+#endif // UIOREGDRIVER_HPP
@@ -3,9 +3,19 @@
 
 #include <iostream>
 #include <string.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
 using namespace std;
 #include "wrapperregdriver.h"
+#include "bufferallocator.hpp"
+#include "checkpoint.hpp"
+#include "emumemmodel.hpp"
+#include "sparsemem.hpp"
 #include "VTesterWrapper.h"
+#include "TesterMemPorts.h"
 
 #ifdef DEBUG
 #define __TESTERDRIVER_DEBUG_PRINT(x) (cout << x << endl)
@@ -18,8 +28,46 @@ using namespace std;
 #define __TESTERDRIVER_DEBUG(x) (0)
 #endif
 
+// memory port hooks, expanded for each port in TESTER_MEM_PORTS. before the
+// clock edge, supply the read data and let the timing model stall the ports.
+// once the inputs have settled, do the writes and tell the timing model which
+// requests and beats go through at the edge.
+#define __TESTER_MEM_IN(i) \
+  m_inst->io_memData_##i##_rdData = m_mem->read64(m_inst->io_memData_##i##_rdAddr); \
+  m_inst->io_memTiming_##i##_rdStall = m_memModel ? m_memModel->readStall(i) : 0; \
+  m_inst->io_memTiming_##i##_wrStall = m_memModel ? m_memModel->writeStall(i) : 0;
+#define __TESTER_MEM_OUT(i) \
+  if(m_inst->io_memData_##i##_wrEn) \
+    m_mem->write64(m_inst->io_memData_##i##_wrAddr, m_inst->io_memData_##i##_wrData); \
+  if(m_memModel) { \
+    if(m_inst->io_memTiming_##i##_rdReqFire) \
+      m_memModel->readRequest(i, m_inst->io_memTiming_##i##_rdReqAddr, m_inst->io_memTiming_##i##_rdReqBytes); \
+    if(m_inst->io_memTiming_##i##_wrReqFire) \
+      m_memModel->writeRequest(i, m_inst->io_memTiming_##i##_wrReqAddr, m_inst->io_memTiming_##i##_wrReqBytes); \
+    if(m_inst->io_memTiming_##i##_rdBeatFire) m_memModel->readBeat(i); \
+    if(m_inst->io_memTiming_##i##_wrBeatFire) m_memModel->writeBeat(i); \
+  }
+
+// waveform tracing: compile with -DTRACE for VCD output, add -DTRACE_FST for
+// compressed FST output (the model must be verilated with --trace or
+// --trace-fst respectively, see verilator-build.sh). nothing is dumped until
+// tracing is armed, see the trace control functions below.
 #ifdef TRACE
+#ifdef TRACE_FST
+#include "verilated_fst_c.h"
+typedef VerilatedFstC VerilatedTraceFile;
+#define TRACE_DEFAULT_FILE "trace.fst"
+#else
 #include "verilated_vcd_c.h"
+typedef VerilatedVcdC VerilatedTraceFile;
+#define TRACE_DEFAULT_FILE "trace.vcd"
+#endif
+#endif
+
+// checkpointing needs a model verilated with --savable, and -DSAVABLE
+// (SAVABLE=1 for verilator-build.sh does both)
+#ifdef SAVABLE
+#include "verilated_save.h"
 #endif
 
 // register driver for the verilated testers (useful for e.g. Chisel-generated TesterWrapper verilog plus external verilog modules for blackboxes)
@@ -28,89 +76,139 @@ using namespace std;
 
 class VerilatedTesterRegDriver : public WrapperRegDriver {
 public:
-  VerilatedTesterRegDriver() {m_freePtr = 0; m_time = 0; Verilated::traceEverOn(true);}
+  VerilatedTesterRegDriver() {
+    m_inst = 0; m_mem = 0; m_allocator = 0; m_time = 0; m_cycle = 0; m_chargeCopyCycles = false; m_lastWaitCycles = 0;
+    m_memModel = 0; m_memModelOn = false;
+    m_irqLevel = false; m_hasIrqReg = false; m_irqReg = 0;
+    m_irqFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(m_irqFd < 0)
+      throw "Could not create interrupt eventfd";
+    // EMU_MEM_MODEL selects a memory model preset without recompiling
+    const char * envMem = getenv("EMU_MEM_MODEL");
+    if(envMem) setMemModel(EmuMemModel::preset(envMem));
+    m_traceOn = false; m_traceStopCycle = 0;
+    m_traceWindowStart = m_traceWindowEnd = 0; m_traceWindowArmed = false;
+    m_traceTrigEnabled = false; m_traceTrigReg = 0; m_traceTrigValue = 0; m_traceTrigCycles = 0;
+    m_traceDepth = 4; m_traceFileName = "";
+#ifdef TRACE
+    m_tfp = 0;
+    m_traceFileName = TRACE_DEFAULT_FILE;
+    Verilated::traceEverOn(true);
+    // TRACE_START and TRACE_CYCLES select a trace window without recompiling
+    const char * envStart = getenv("TRACE_START");
+    const char * envCycles = getenv("TRACE_CYCLES");
+    if(envStart || envCycles) {
+      uint64_t start = envStart ? strtoull(envStart, 0, 10) : 0;
+      uint64_t cycles = envCycles ? strtoull(envCycles, 0, 10) : ~(uint64_t) 0 - start;
+      setTraceWindow(start, start + cycles);
+    }
+#endif
+  }
 
+  virtual ~VerilatedTesterRegDriver() {
+    detach();
+    close(m_irqFd);
+  }
+
+  // attaching again without detaching first drops the previous model and
+  // all its buffers
   virtual void attach(const char * name) {
+    detach();
     m_inst = new VTesterWrapper();
-#ifdef TRACE
-    m_tfp = new VerilatedVcdC;
-    m_inst->trace(m_tfp, 4);
-    m_tfp->open("trace.vcd");
-#endif
+    m_time = 0; m_cycle = 0;
+    m_traceWindowArmed = false;
 
-    // get # words in the memory -- TODO get from verilator?
-    m_memWords = 1024*1024;
+    // main memory covers the accelerator's whole address space, but only
+    // takes up host memory for the pages actually used
+    m_mem = new SparseMem(TESTER_MEM_ADDR_BITS);
+    m_allocator = new BufferAllocator(0, m_mem->size());
     // initialize and reset the model
     reset();
+    m_irqLevel = false;
+    if(m_memModelOn) m_memModel = new EmuMemModel(m_memParams, TESTER_NUM_MEM_PORTS);
     m_regCount = m_inst->io_regFileIF_regCount;
-    cout << "memwords " << m_memWords << " regs " << m_regCount << endl;
+    cout << "membits " << TESTER_MEM_ADDR_BITS << " regs " << m_regCount << endl;
   }
 
   virtual void detach() {
 #ifdef TRACE
-    m_tfp->close();
-    delete m_tfp;
+    if(m_tfp) {
+      m_tfp->close();
+      delete m_tfp;
+      m_tfp = 0;
+    }
+    m_traceOn = false;
 #endif
     delete m_inst;
+    m_inst = 0;
+    delete m_allocator;
+    m_allocator = 0;
+    delete m_mem;
+    m_mem = 0;
+    delete m_memModel;
+    m_memModel = 0;
   }
 
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    __TESTERDRIVER_DEBUG_PRINT("host2accel(" << (uint64_t) hostBuffer << " -> " << accelBufBase << " : " << numBytes << " bytes)");
-
-    if((numBytes % 8 == 0) && (accelBufBase % 8 == 0))
-      alignedCopyBufferHostToAccel(hostBuffer, accelBuffer, numBytes);
-    else {
-      // align base and size
-      uint64_t alignedBase = accelBufBase - (accelBufBase % 8);
-      uint64_t startDiff = accelBufBase - alignedBase;
-      unsigned int alignedSize = (startDiff + numBytes + 7) / 8 * 8;
-      // copy containing block into host memory
-      char * tmp = new char[alignedSize];
-      alignedCopyBufferAccelToHost((void *)alignedBase, (void *) tmp, alignedSize);
-      // do host-to-host unaligned copy
-      memcpy((void *)&tmp[startDiff], hostBuffer, numBytes);
-      // write containing block back to accel memory
-      alignedCopyBufferHostToAccel((void *)tmp, (void *)alignedBase, alignedSize);
-      delete [] tmp;
-    }
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
+    __TESTERDRIVER_DEBUG_PRINT("host2accel(" << (uint64_t) hostBuffer << " -> " << (uint64_t) accelBuffer << " : " << numBytes << " bytes)");
+    m_mem->write((uint64_t) accelBuffer, hostBuffer, numBytes);
+    if(m_chargeCopyCycles) step((numBytes + 7) / 8);
   }
 
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    __TESTERDRIVER_DEBUG_PRINT("accel2host(" << accelBufBase << " -> " << (uint64_t) hostBuffer << " : " << numBytes << " bytes)");
-
-    if((numBytes % 8 == 0) && (accelBufBase % 8 == 0))
-      alignedCopyBufferAccelToHost(accelBuffer, hostBuffer, numBytes);
-    else {
-      // implement unaligned accel-to-host
-      // align base and size
-      uint64_t alignedBase = accelBufBase - (accelBufBase % 8);
-      uint64_t startDiff = accelBufBase - alignedBase;
-      unsigned int alignedSize = (startDiff + numBytes + 7) / 8 * 8;
-      // copy containing block into host memory
-      char * tmp = new char[alignedSize];
-      alignedCopyBufferAccelToHost((void *)alignedBase, (void *) tmp, alignedSize);
-      // do host-to-host unaligned copy
-      memcpy(hostBuffer, (void *)&tmp[startDiff],numBytes);
-      delete [] tmp;
-    }
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
+    __TESTERDRIVER_DEBUG_PRINT("accel2host(" << (uint64_t) accelBuffer << " -> " << (uint64_t) hostBuffer << " : " << numBytes << " bytes)");
+    m_mem->read((uint64_t) accelBuffer, hostBuffer, numBytes);
+    if(m_chargeCopyCycles) step((numBytes + 7) / 8);
   }
 
-  virtual void * allocAccelBuffer(unsigned int numBytes) {
-    // all this assumes allocation and mem word size of 8 bytes
-    // round requested size to nearest multiple of 8
-    unsigned int actualAllocSize = (numBytes + 7) / 8 * 8;
-    void * accelBuf = (void *) m_freePtr;
-    // update free pointer and sanity check
-    m_freePtr += actualAllocSize;
-    if(m_freePtr > m_memWords * 8)
-      throw "Not enough memory in allocAccelBuffer";
-    __TESTERDRIVER_DEBUG_PRINT("allocAccelBuffer(" << numBytes << ", alloc " << actualAllocSize <<") = " << (uint64_t) accelBuf);
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
+    // buffers are 64-byte aligned, which also satisfies the mem word size
+    void * accelBuf = (void *) m_allocator->alloc(numBytes);
+    __TESTERDRIVER_DEBUG_PRINT("allocAccelBuffer(" << numBytes << ", alloc " << m_allocator->allocSize((uint64_t) accelBuf) <<") = " << (uint64_t) accelBuf);
 
     return accelBuf;
   }
 
+  virtual void deallocAccelBuffer(void * buffer) {
+    __TESTERDRIVER_DEBUG_PRINT("deallocAccelBuffer(" << (uint64_t) buffer << ")");
+    m_allocator->dealloc((uint64_t) buffer);
+  }
+
+  const BufferAllocator & getAllocator() { return *m_allocator; }
+
+  // host-accel buffer copies go straight into the main memory, without
+  // clocking the model. enable this to charge the copies in idle cycles:
+  // after each copy, the clock runs for one cycle per 8 bytes copied, about
+  // what the copies through the old testbench memory port took. the data is
+  // still written instantly and does not go through the memory ports, so
+  // this only shifts the cycle counts, it does not model contention.
+  void setChargeCopyCycles(bool enable) {m_chargeCopyCycles = enable;}
+
+  // number of main memory pages that have been written to
+  uint64_t getTouchedPages() {return m_mem ? m_mem->getTouchedPages() : 0;}
+
+  // DRAM timing model for the accelerator memory ports, see emumemmodel.hpp.
+  // the model state starts out idle on every attach.
+  void setMemModel(const EmuMemParams & p) {
+    EmuMemModel::checkParams(p);
+    m_memParams = p;
+    m_memModelOn = true;
+    if(m_inst) {
+      delete m_memModel;
+      m_memModel = new EmuMemModel(m_memParams, TESTER_NUM_MEM_PORTS);
+    }
+  }
+
+  void clearMemModel() {
+    m_memModelOn = false;
+    delete m_memModel;
+    m_memModel = 0;
+    if(m_inst) {TESTER_MEM_PORTS(__TESTER_MEM_IN)}
+  }
+
+  // for the model statistics, 0 if there is no model
+  EmuMemModel * getMemModel() {return m_memModel;}
+
   // register access methods for the platform wrapper
   virtual void writeReg(unsigned int regInd, AccelReg regValue) {
     __TESTERDRIVER_DEBUG_PRINT("writeReg(" << regInd << ", " << regValue  << ") ");
@@ -119,6 +217,7 @@ public:
     m_inst->io_regFileIF_cmd_bits_write  = 1;
     m_inst->io_regFileIF_cmd_bits_regID = regInd;
     m_inst->io_regFileIF_cmd_valid = 1;
+    checkTraceTrigger(regInd, regValue);
     step();
     m_inst->io_regFileIF_cmd_valid = 0;
     m_inst->io_regFileIF_cmd_bits_write = 0;
@@ -148,6 +247,238 @@ public:
     return ret;
   }
 
+  // batched register access: commands are issued back-to-back, one cycle
+  // each, with a single completion delay at the end of the batch
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    m_inst->io_regFileIF_cmd_bits_write = 1;
+    m_inst->io_regFileIF_cmd_valid = 1;
+    for(unsigned int i = 0; i < numRegs; i++) {
+      __TESTERDRIVER_DEBUG_PRINT("writeRegs(" << regInds[i] << ", " << regValues[i]  << ") ");
+      m_inst->io_regFileIF_cmd_bits_writeData = regValues[i];
+      m_inst->io_regFileIF_cmd_bits_regID = regInds[i];
+      checkTraceTrigger(regInds[i], regValues[i]);
+      step();
+    }
+    m_inst->io_regFileIF_cmd_valid = 0;
+    m_inst->io_regFileIF_cmd_bits_write = 0;
+    step(5);
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    m_inst->io_regFileIF_cmd_bits_read = 1;
+    m_inst->io_regFileIF_cmd_valid = 1;
+    for(unsigned int i = 0; i < numRegs; i++) {
+      m_inst->io_regFileIF_cmd_bits_regID = regInds[i];
+      step();
+      if(!m_inst->io_regFileIF_readData_valid)
+        throw "Could not read register";
+      regValues[i] = m_inst->io_regFileIF_readData_bits;
+      __TESTERDRIVER_DEBUG_PRINT("readRegs(" << regInds[i] << ") = " << regValues[i]);
+    }
+    m_inst->io_regFileIF_cmd_valid = 0;
+    m_inst->io_regFileIF_cmd_bits_read = 0;
+    step(5);
+  }
+
+  // run the clock until the register holds the expected value. a read
+  // command is kept asserted throughout, so the register file returns the
+  // current value every cycle without any further register accesses
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    uint64_t start = timestampUs();
+    bool done = false;
+    m_lastWaitCycles = 0;
+    m_inst->io_regFileIF_cmd_bits_regID = regInd;
+    m_inst->io_regFileIF_cmd_bits_read = 1;
+    m_inst->io_regFileIF_cmd_valid = 1;
+    while(!done) {
+      step();
+      m_lastWaitCycles++;
+      done = m_inst->io_regFileIF_readData_valid && ((AccelReg) m_inst->io_regFileIF_readData_bits == expValue);
+      // only check the host clock once in a while, it costs more than a cycle
+      if(!done && timeoutUs != 0 && (m_lastWaitCycles % 1024 == 0))
+        if(timestampUs() - start >= timeoutUs) break;
+    }
+    m_inst->io_regFileIF_cmd_valid = 0;
+    m_inst->io_regFileIF_cmd_bits_read = 0;
+    // the wait consumed the completion event, as on the UIO platforms
+    if(done && m_hasIrqReg && regInd == m_irqReg) clearInterrupt();
+    m_lastWaitUs = timestampUs() - start;
+    __TESTERDRIVER_DEBUG_PRINT("waitForCompletion(" << regInd << ", " << expValue << ") = " << done << " after " << m_lastWaitCycles << " cycles");
+    return done;
+  }
+
+  // stand-in for the completion interrupt of the real platforms: an eventfd
+  // that is signalled whenever the model's irq output rises. the model only
+  // runs inside driver calls, so the fd becomes readable during
+  // waitForCompletion or other register accesses, not in the background.
+  virtual void setInterruptReg(unsigned int regInd) {
+    m_irqReg = regInd;
+    m_hasIrqReg = true;
+  }
+
+  virtual int getInterruptFd() {return m_irqFd;}
+
+  virtual void clearInterrupt() {
+    uint64_t count;
+    // nothing to read if the interrupt has not fired
+    if(read(m_irqFd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+      throw "Could not read interrupt eventfd";
+  }
+
+  // number of clock cycles run by the last waitForCompletion call
+  uint64_t getLastWaitCycles() {return m_lastWaitCycles;}
+
+  // clock cycles since attach
+  uint64_t getCycleCount() {return m_cycle;}
+
+  // checkpointing: the allocator layout and optional application data
+  // (e.g. buffer addresses) are followed by the memory timing model state,
+  // the touched main memory pages and the model state, the latter written
+  // with Verilator's serialization. the model must be attached, and
+  // restoring must use the same model build (checked with the fingerprint
+  // from TesterMemPorts.h) and the same memory model. Verilator's restore is
+  // a stream, so unlike the Chisel driver this reads the whole checkpoint.
+  void saveCheckpoint(const char * fileName, const void * userData = 0, uint64_t userBytes = 0) {
+#ifdef SAVABLE
+    CheckpointHeader hdr;
+    hdr.kind = CHECKPOINT_KIND_VERILATED;
+    hdr.modelBytes = sizeof(VTesterWrapper);
+    hdr.fingerprint = TESTER_MODEL_FINGERPRINT;
+    hdr.cycle = m_cycle;
+    saveIrqState(hdr);
+    hdr.hasMemModel = (m_memModel != 0);
+    hdr.imageOffset = 0;  // model state follows the metadata in the stream
+    hdr.memPages = m_mem->getTouchedPages();
+    hdr.memOffset = 0;
+    std::string meta = CheckpointMeta::serialize(hdr, *m_allocator, userData, userBytes);
+    uint64_t metaBytes = meta.size();
+    VerilatedSave os;
+    os.open(fileName);
+    if(!os.isOpen())
+      throw "Could not write checkpoint file";
+    os.write(&metaBytes, sizeof(metaBytes));
+    os.write(meta.data(), metaBytes);
+    os.write(&m_time, sizeof(m_time));
+    if(m_memModel) m_memModel->save(os);
+    m_mem->save(os);
+    os << *m_inst;
+    os.close();
+#else
+    throw "Checkpointing needs a model verilated with --savable and -DSAVABLE";
+#endif
+  }
+
+  // if anything does not match, this throws and the driver state is
+  // unchanged
+  void restoreCheckpoint(const char * fileName, void * userData = 0, uint64_t userBytes = 0) {
+#ifdef SAVABLE
+    CheckpointHeader hdr;
+    std::string user;
+    uint64_t time = 0;
+    BufferAllocator * allocator = new BufferAllocator(0, m_mem->size());
+    SparseMem * mem = new SparseMem(TESTER_MEM_ADDR_BITS);
+    EmuMemModel * memModel = 0;
+    VerilatedRestore is;
+    try {
+      uint64_t fileBytes = CheckpointMeta::fileSize(fileName);
+      is.open(fileName);
+      if(!is.isOpen())
+        throw "Could not open checkpoint file";
+      uint64_t metaBytes = 0;
+      is.read(&metaBytes, sizeof(metaBytes));
+      if(metaBytes > fileBytes)
+        throw "Checkpoint file truncated";
+      std::string meta(metaBytes, '\0');
+      is.read(&meta[0], metaBytes);
+      std::istringstream metaStream(meta);
+      CheckpointMeta::deserialize(metaStream, fileBytes, hdr, CHECKPOINT_KIND_VERILATED, sizeof(VTesterWrapper),
+        TESTER_MODEL_FINGERPRINT, *allocator, user);
+      if((hdr.hasMemModel != 0) != (m_memModel != 0))
+        throw "Checkpoint was saved with a different memory model";
+      // at least the metadata and the memory pages must be there
+      uint64_t memBytes = hdr.memPages * (sizeof(uint64_t) + SparseMem::PAGE_BYTES);
+      if(memBytes > fileBytes || fileBytes - memBytes < 3 * sizeof(uint64_t) + metaBytes)
+        throw "Checkpoint file truncated";
+      is.read(&time, sizeof(time));
+      if(m_memModel) {
+        memModel = new EmuMemModel(m_memParams, TESTER_NUM_MEM_PORTS);
+        memModel->restore(is);
+      }
+      mem->restore(is);
+    } catch(...) {
+      is.close();
+      delete allocator;
+      delete mem;
+      delete memModel;
+      throw;
+    }
+    // the model goes last, Verilator stops the process if it does not match
+    is >> *m_inst;
+    is.close();
+    delete m_allocator;
+    m_allocator = allocator;
+    delete m_mem;
+    m_mem = mem;
+    delete m_memModel;
+    m_memModel = memModel;
+    m_time = time;
+    m_cycle = hdr.cycle;
+    m_traceWindowArmed = false;
+    CheckpointMeta::copyUserData(user, userData, userBytes);
+    restoreIrqState(hdr);
+#else
+    throw "Checkpointing needs a model verilated with --savable and -DSAVABLE";
+#endif
+  }
+
+  // trace control. these are no-ops unless compiled with -DTRACE.
+  // start dumping now, for numCycles cycles (0 = until traceDisarm)
+  void traceArm(uint64_t numCycles = 0) {
+#ifdef TRACE
+    if(!m_tfp) openTrace();
+    m_traceOn = true;
+    m_traceStopCycle = (numCycles == 0) ? 0 : m_cycle + numCycles;
+#endif
+  }
+
+  void traceDisarm() {
+#ifdef TRACE
+    m_traceOn = false;
+    if(m_tfp) m_tfp->flush();
+#endif
+  }
+
+  bool isTraceArmed() {return m_traceOn;}
+
+  // trace the cycles in [startCycle, endCycle), counted from attach. the
+  // cycle count restarts on every attach, so the window is traced again for
+  // each accelerator object that runs that long, and detach closes the trace
+  // file: the file left at the end holds the window of the last of them. if
+  // the model is already past startCycle (set late, or after restoring a
+  // checkpoint), tracing starts right away for the rest of the window.
+  void setTraceWindow(uint64_t startCycle, uint64_t endCycle) {
+    m_traceWindowStart = startCycle;
+    m_traceWindowEnd = endCycle;
+    m_traceWindowArmed = false;
+  }
+
+  // arm tracing for numCycles cycles (0 = until disarmed) when the host
+  // writes value into register regInd, e.g. the accelerator start register
+  void setTraceRegTrigger(unsigned int regInd, AccelReg value, uint64_t numCycles = 0) {
+    m_traceTrigEnabled = true;
+    m_traceTrigReg = regInd;
+    m_traceTrigValue = value;
+    m_traceTrigCycles = numCycles;
+  }
+
+  void clearTraceRegTrigger() {m_traceTrigEnabled = false;}
+
+  // number of hierarchy levels to trace (default 4, raise it to see deeper
+  // into the accelerator), and the output file. these take effect when the
+  // trace file is opened, i.e. when tracing is first armed
+  void setTraceDepth(int levels) {m_traceDepth = levels;}
+  void setTraceFile(const char * fileName) {m_traceFileName = fileName;}
+
   void printAllRegs() {
     for(unsigned int i = 0; i < m_regCount; i++)  {
         AccelReg val = readReg(i);
@@ -158,11 +489,83 @@ public:
 
 protected:
   VTesterWrapper * m_inst;
-  unsigned int m_memWords;
+  SparseMem * m_mem;
   unsigned int m_regCount;
-  uint64_t m_freePtr;
-  unsigned int m_time;
-  VerilatedVcdC * m_tfp;
+  BufferAllocator * m_allocator;
+  bool m_chargeCopyCycles;
+  uint64_t m_lastWaitCycles;
+  uint64_t m_time;   // trace timestamp, two per clock cycle
+  uint64_t m_cycle;
+  EmuMemModel * m_memModel;
+  EmuMemParams m_memParams;
+  bool m_memModelOn;
+  // completion interrupt stand-in
+  int m_irqFd;
+  bool m_irqLevel;
+  bool m_hasIrqReg;
+  unsigned int m_irqReg;
+
+  // the irq level and an unconsumed event, for checkpoints
+  void saveIrqState(CheckpointHeader & hdr) {
+    uint64_t count = 0;
+    hdr.irqLevel = m_irqLevel;
+    hdr.irqPending = (read(m_irqFd, &count, sizeof(count)) == sizeof(count));
+    // put the event back, saving must not consume it
+    if(hdr.irqPending && write(m_irqFd, &count, sizeof(count)) != sizeof(count))
+      throw "Could not signal interrupt eventfd";
+  }
+
+  void restoreIrqState(const CheckpointHeader & hdr) {
+    clearInterrupt();
+    m_irqLevel = (hdr.irqLevel != 0);
+    uint64_t one = 1;
+    if(hdr.irqPending && write(m_irqFd, &one, sizeof(one)) != sizeof(one))
+      throw "Could not signal interrupt eventfd";
+  }
+
+  void updateIrq(bool level) {
+    if(level && !m_irqLevel) {
+      uint64_t one = 1;
+      if(write(m_irqFd, &one, sizeof(one)) != sizeof(one))
+        throw "Could not signal interrupt eventfd";
+    }
+    m_irqLevel = level;
+  }
+  // trace state
+  bool m_traceOn;
+  uint64_t m_traceStopCycle;
+  uint64_t m_traceWindowStart, m_traceWindowEnd;
+  bool m_traceWindowArmed;    // window was armed since attach or restore
+  bool m_traceTrigEnabled;
+  unsigned int m_traceTrigReg;
+  AccelReg m_traceTrigValue;
+  uint64_t m_traceTrigCycles;
+  int m_traceDepth;
+  string m_traceFileName;
+#ifdef TRACE
+  VerilatedTraceFile * m_tfp;
+
+  void openTrace() {
+    m_tfp = new VerilatedTraceFile;
+    m_inst->trace(m_tfp, m_traceDepth);
+    m_tfp->open(m_traceFileName.c_str());
+  }
+#endif
+
+  void checkTraceTrigger(unsigned int regInd, AccelReg regValue) {
+    if(m_traceTrigEnabled && regInd == m_traceTrigReg && regValue == m_traceTrigValue)
+      traceArm(m_traceTrigCycles);
+  }
+
+  // called once per cycle, before the cycle is dumped
+  void updateTrace() {
+    if(!m_traceWindowArmed && m_cycle >= m_traceWindowStart && m_cycle < m_traceWindowEnd) {
+      m_traceWindowArmed = true;
+      traceArm(m_traceWindowEnd - m_cycle);
+    }
+    if(m_traceOn && m_traceStopCycle != 0 && m_cycle >= m_traceStopCycle)
+      traceDisarm();
+  }
 
 
   void reset() {
@@ -172,52 +575,35 @@ protected:
     step(1);
   }
 
-  void step(int n = 1) {
-    for(int i = 0; i < n; i++) {
+  // 64-bit count, copies charged in cycles can be larger than 2^31 words
+  void step(uint64_t n = 1) {
+    for(uint64_t i = 0; i < n; i++) {
+#ifdef TRACE
+      updateTrace();
+#endif
+      if(TESTER_NUM_MEM_PORTS > 0) {
+        if(m_memModel) m_memModel->beginCycle();
+        TESTER_MEM_PORTS(__TESTER_MEM_IN)
+        m_inst->eval();
+        TESTER_MEM_PORTS(__TESTER_MEM_OUT)
+        if(m_memModel) m_memModel->endCycle();
+      }
       m_inst->clk = 1;
       m_inst->eval();
 #ifdef TRACE
-      m_tfp->dump(m_time);
+      if(m_traceOn) m_tfp->dump(m_time);
 #endif
       m_time++;
       m_inst->clk = 0;
       m_inst->eval();
 #ifdef TRACE
-      m_tfp->dump(m_time);
+      if(m_traceOn) m_tfp->dump(m_time);
 #endif
       m_time++;
+      m_cycle++;
+      updateIrq(m_inst->io_irq);
     }
   }
-
-  void memWrite(uint64_t addr, uint64_t value) {
-    m_inst->io_memAddr = addr;
-    m_inst->io_memWriteData = value;
-    m_inst->io_memWriteEn = 1;
-    step();
-    m_inst->io_memWriteEn = 0;
-  }
-
-  uint64_t memRead(uint64_t addr) {
-    m_inst->io_memAddr = addr;
-    step();
-    uint64_t ret = m_inst->io_memReadData;
-    return ret;
-  }
-
-  // "aligned" copy functions, where accel ptr start and size are guaranteed to be 8-aligned
-  void alignedCopyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
-    uint64_t * host_buf = (uint64_t *) hostBuffer;
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    for(unsigned int i = 0; i < numBytes/8; i++)
-        memWrite(accelBufBase + i*8, host_buf[i]);
-  }
-
-  void alignedCopyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
-    uint64_t accelBufBase = (uint64_t) accelBuffer;
-    uint64_t * readBuf = (uint64_t *) hostBuffer;
-    for(unsigned int i = 0; i < numBytes/8; i++)
-      readBuf[i] = memRead(accelBufBase + i*8);
-  }
 };
 
 #endif
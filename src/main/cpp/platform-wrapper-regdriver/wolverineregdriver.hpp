@@ -78,17 +78,17 @@ public:
   }
 
   // functions to ensure coherency across host-accelerator
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
     if(!wdm_memcpy(m_coproc, accelBuffer, hostBuffer, numBytes))
       throw "Error in copyBufferHostToAccel";
   }
 
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
     if(!wdm_memcpy(m_coproc, hostBuffer, accelBuffer, numBytes))
       throw "Error in copyBufferAccelToHost";
   }
 
-  virtual void * allocAccelBuffer(unsigned int numBytes) {
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
     void * accelBuf;
     if(wdm_posix_memalign(m_coproc, &accelBuf, 64, numBytes) != 0)
       throw "Error in allocAccelBuffer";
@@ -105,7 +105,7 @@ public:
   virtual AccelReg readReg(unsigned int regInd) {
     uint64_t ret = 0;
     cny_fwd_read((char *)"aemc0", 0x30000 + 0x8*regInd, &ret);
-    return (AccelReg) ret;
+    return ret;
   }
 
 protected:
@@ -7,6 +7,7 @@ extern "C"
 }
 
 #include <stdint.h>
+#include <vector>
 #include "wrapperregdriver.h"
 
 void *memset(void *dst, int c, size_t n)
@@ -66,17 +67,17 @@ public:
   }
 
   // functions to ensure coherency across host-accelerator
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
     if(!wdm_memcpy(m_coproc, accelBuffer, hostBuffer, numBytes))
       throw "Error in copyBufferHostToAccel";
   }
 
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
     if(!wdm_memcpy(m_coproc, hostBuffer, accelBuffer, numBytes))
       throw "Error in copyBufferAccelToHost";
   }
 
-  virtual void * allocAccelBuffer(unsigned int numBytes) {
+  virtual void * allocAccelBuffer(uint64_t numBytes) {
     void * accelBuf;
     if(wdm_posix_memalign(m_coproc, &accelBuf, 64, numBytes) != 0)
       throw "Error in allocAccelBuffer";
@@ -105,12 +106,55 @@ public:
     if(wdm_aeg_write_read(m_coproc, &ds) != 0)
       throw "wdm_aeg_write_read failed in readReg";
 
-    return (AccelReg) ret;
+    return ret;
+  }
+
+  // batched register access: each run of consecutive register indices is
+  // transferred with a single multi-AEG access
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    std::vector<uint64_t> regs(numRegs);
+    unsigned int i = 0;
+    while(i < numRegs) {
+      unsigned int cnt = contiguousRun(numRegs - i, &regInds[i]);
+      for(unsigned int j = 0; j < cnt; j++) regs[j] = regValues[i+j];
+      wdm_dispatch_t ds;
+      memset((void *)&ds, 0, sizeof(ds));
+      ds.ae[0].aeg_ptr_s = &regs[0];
+      ds.ae[0].aeg_cnt_s = cnt;
+      ds.ae[0].aeg_base_s = regInds[i];
+      if(wdm_aeg_write_read(m_coproc, &ds) != 0)
+        throw "wdm_aeg_write_read failed in writeRegs";
+      i += cnt;
+    }
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    std::vector<uint64_t> regs(numRegs);
+    unsigned int i = 0;
+    while(i < numRegs) {
+      unsigned int cnt = contiguousRun(numRegs - i, &regInds[i]);
+      wdm_dispatch_t ds;
+      memset((void *)&ds, 0, sizeof(ds));
+      ds.ae[0].aeg_ptr_r = &regs[0];
+      ds.ae[0].aeg_cnt_r = cnt;
+      ds.ae[0].aeg_base_r = regInds[i];
+      if(wdm_aeg_write_read(m_coproc, &ds) != 0)
+        throw "wdm_aeg_write_read failed in readRegs";
+      for(unsigned int j = 0; j < cnt; j++) regValues[i+j] = regs[j];
+      i += cnt;
+    }
   }
 
 protected:
   wdm_coproc_t m_coproc;
 
+  // number of leading entries in regInds that are consecutive indices
+  unsigned int contiguousRun(unsigned int numRegs, const unsigned int * regInds) {
+    unsigned int cnt = 1;
+    while(cnt < numRegs && regInds[cnt] == regInds[0] + cnt) cnt++;
+    return cnt;
+  }
+
 };
 
 #endif // WOLVERINEREGDRIVERDEBUG_H
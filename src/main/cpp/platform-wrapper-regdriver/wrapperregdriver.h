@@ -2,29 +2,162 @@
 #define WRAPPERREGDRIVER_H
 
 #include <stdint.h>
+#ifdef __unix__
+#include <time.h>
+#include <sched.h>
+#include "mappedfile.hpp"
+#endif
 
-// TODO wrapper driver should be a singleton
-typedef unsigned int AccelReg;
+// a register value. the CSR width is set per platform (csrDataBits in
+// PlatformWrapperParams: 32 bits on the AXI platforms, 64 on the WX690T), so
+// this holds the widest one. on 32-bit platforms the upper half is zero.
+typedef uint64_t AccelReg;
 typedef uint64_t AccelDblReg;
+// value of a signal spanning N > 2 registers, least significant word first
+template <unsigned int N> struct AccelWideReg {
+  AccelReg words[N];
+};
 
+// initPlatform() hands out a single shared instance per process. drivers are
+// not thread-safe themselves, wrap them in a ThreadSafeRegDriver to share one
+// between host threads.
 class WrapperRegDriver
 {
 public:
+  WrapperRegDriver() {m_lastWaitUs = 0;}
   virtual ~WrapperRegDriver() {}
   // (optional) functions for host-accelerator buffer management
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {}
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {}
-  virtual void * allocAccelBuffer(unsigned int numBytes) {return 0;}
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {}
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {}
+  virtual void * allocAccelBuffer(uint64_t numBytes) {return 0;}
   virtual void deallocAccelBuffer(void * buffer) {}
 
+  // (optional) zero-copy access to accelerator buffers. returns a host pointer
+  // through which the buffer can be accessed directly, or 0 if the platform
+  // does not support this (use the copy functions above instead). call
+  // syncBufferForAccel after writing through the pointer and before the
+  // accelerator reads the data, and syncBufferForHost after the accelerator
+  // has written the buffer and before reading it through the pointer.
+  virtual void * getHostPointer(void * accelBuffer) {return 0;}
+  virtual void syncBufferForAccel(void * accelBuffer, uint64_t numBytes) {}
+  virtual void syncBufferForHost(void * accelBuffer, uint64_t numBytes) {}
+
+  // (optional) load a whole file into an accelerator buffer, which must be
+  // at least as large as the file. returns the number of bytes loaded. the
+  // default maps the file and copies it over in chunks, without staging it
+  // in a host buffer first.
+  virtual uint64_t loadFileToAccel(const char * fileName, void * accelBuffer) {
+#ifdef __unix__
+    const uint64_t chunkBytes = 16 * 1024 * 1024;
+    MappedFile f(fileName);
+    for(uint64_t offset = 0; offset < f.size(); offset += chunkBytes) {
+      uint64_t n = (f.size() - offset < chunkBytes) ? f.size() - offset : chunkBytes;
+      copyBufferHostToAccel((void *) (f.data() + offset), (void *) ((uintptr_t) accelBuffer + offset), n);
+      f.release(offset, n);
+    }
+    return f.size();
+#else
+    throw "loadFileToAccel is not supported on this platform";
+#endif
+  }
+
+  // true if buffer copies may run on another thread while the accelerator is
+  // being accessed through registers (used to overlap transfers and compute)
+  virtual bool supportsConcurrentCopy() {return false;}
+  // true if single register accesses from different threads need no locking
+  virtual bool supportsConcurrentRegAccess() {return false;}
+
   // (optional) functions for accelerator attach-detach handling
   virtual void attach(const char * name) {}
   virtual void detach() {}
 
+  // (optional) marks a register whose writes have side effects (e.g. start),
+  // called by the accelerator drivers after attaching. layers that cache
+  // register writes (ShadowRegDriver) always pass these through
+  virtual void setVolatileReg(unsigned int regInd) {}
+
+  // (optional) completion interrupt. the accelerator drivers call
+  // setInterruptReg with the register of their finished output after
+  // attaching. on platforms with an interrupt line, waitForCompletion for
+  // that register then sleeps until the interrupt instead of polling.
+  // getInterruptFd returns a file descriptor that becomes readable when the
+  // interrupt fires, for use with poll/select in event loops, or -1 if there
+  // is none. call clearInterrupt once it was readable to consume the event
+  // and re-arm the interrupt.
+  virtual void setInterruptReg(unsigned int regInd) {}
+  virtual int getInterruptFd() {return -1;}
+  virtual void clearInterrupt() {}
+
   // (mandatory) register access methods for the platform wrapper
   virtual void writeReg(unsigned int regInd, AccelReg regValue) = 0;
   virtual AccelReg readReg(unsigned int regInd) = 0;
 
+  // (optional) batched register access, in the given order. platforms where
+  // each register access is a costly transaction should override these to
+  // issue the whole batch at once
+  virtual void writeRegs(unsigned int numRegs, const unsigned int * regInds, const AccelReg * regValues) {
+    for(unsigned int i = 0; i < numRegs; i++)
+      writeReg(regInds[i], regValues[i]);
+  }
+
+  virtual void readRegs(unsigned int numRegs, const unsigned int * regInds, AccelReg * regValues) {
+    for(unsigned int i = 0; i < numRegs; i++)
+      regValues[i] = readReg(regInds[i]);
+  }
+
+  // (optional) wait until register regInd reads expValue, or until timeoutUs
+  // microseconds have passed (0 waits forever). returns true if the value was
+  // seen. the default implementation polls with adaptive backoff, emulated
+  // platforms can instead run the clock until the condition holds
+  virtual bool waitForCompletion(unsigned int regInd, AccelReg expValue, uint64_t timeoutUs = 0) {
+    uint64_t start = timestampUs();
+    bool done = false;
+    for(unsigned int polls = 0; !done; polls++) {
+      done = (readReg(regInd) == expValue);
+      if(!done) {
+        if(timeoutUs != 0 && timestampUs() - start >= timeoutUs) break;
+        pollBackoff(polls);
+      }
+    }
+    m_lastWaitUs = timestampUs() - start;
+    return done;
+  }
+
+  // time spent inside the last waitForCompletion call, in microseconds
+  uint64_t getLastWaitTimeUs() {return m_lastWaitUs;}
+
+protected:
+  uint64_t m_lastWaitUs;
+
+  // monotonic host time in microseconds. without an OS clock this returns 0,
+  // which means waitForCompletion timeouts never expire
+  virtual uint64_t timestampUs() {
+#ifdef __unix__
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+  }
+
+  // called between unsuccessful polls: spin at first, since short jobs are
+  // done quickly, then yield the core, then sleep for exponentially growing
+  // intervals capped at 1 ms
+  virtual void pollBackoff(unsigned int polls) {
+#ifdef __unix__
+    if(polls < 64) return;
+    if(polls < 128) {
+      sched_yield();
+      return;
+    }
+    unsigned int shift = (polls - 128) / 8;
+    long sleepUs = (shift >= 10) ? 1000 : (1L << shift);
+    struct timespec ts = {0, sleepUs * 1000};
+    nanosleep(&ts, 0);
+#endif
+  }
+
 };
 
 #endif // WRAPPERREGDRIVER_H
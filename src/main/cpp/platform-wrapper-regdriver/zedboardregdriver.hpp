@@ -11,18 +11,29 @@ public:
   ZedBoardRegDriver(void *baseAddr) : AXIRegDriver(baseAddr) {}
 
   // functions for host-accelerator buffer management
-  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, unsigned int numBytes) {
+  virtual void copyBufferHostToAccel(void * hostBuffer, void * accelBuffer, uint64_t numBytes) {
     memcpy(accelBuffer, hostBuffer, numBytes);
     Xil_DCacheFlushRange((unsigned int) accelBuffer, numBytes);
   }
 
-  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, unsigned int numBytes) {
+  virtual void copyBufferAccelToHost(void * accelBuffer, void * hostBuffer, uint64_t numBytes) {
     Xil_DCacheInvalidateRange((unsigned int) accelBuffer, numBytes);
     memcpy(hostBuffer,accelBuffer, numBytes);
   }
 
-  virtual void * allocAccelBuffer(unsigned int numBytes) { return malloc_aligned(64, numBytes);}
+  virtual void * allocAccelBuffer(uint64_t numBytes) { return malloc_aligned(64, numBytes);}
   virtual void deallocAccelBuffer(void * buffer) { free_aligned(buffer);}
+
+  // accel buffers are regular (cached) host memory
+  virtual void * getHostPointer(void * accelBuffer) { return accelBuffer; }
+
+  virtual void syncBufferForAccel(void * accelBuffer, uint64_t numBytes) {
+    Xil_DCacheFlushRange((unsigned int) accelBuffer, numBytes);
+  }
+
+  virtual void syncBufferForHost(void * accelBuffer, uint64_t numBytes) {
+    Xil_DCacheInvalidateRange((unsigned int) accelBuffer, numBytes);
+  }
   
 protected:
   // custom aligned malloc-free from http://stackoverflow.com/questions/6563120/what-does-posix-memalign-memalign-do
@@ -3,59 +3,77 @@ using namespace std;
 #include <string.h>
 #include "TestCopy.hpp"
 #include "platform.h"
+#include "streamrunner.hpp"
+#include "benchmark.hpp"
 
-bool Run_TestCopy(WrapperRegDriver * platform) {
+BenchSample Run_TestCopy(WrapperRegDriver * platform, uint64_t ub, uint64_t chunkBytes) {
   TestCopy t(platform);
-  cout << "TestCopy test" << endl;
-  cout << "Signature: " << hex << t.get_signature() << dec << endl;
-  unsigned int ub = 0;
-  cout << "Enter number of words to generate and copy: " << endl;
-  cin >> ub;
 
   uint64_t * hostSrc = new uint64_t[ub];
-  unsigned int bufsize = ub * sizeof(uint64_t);
-  unsigned int golden = (ub*(ub+1))/2;
-
-  for(uint64_t i = 0; i < ub; i++) { hostSrc[i] = i+1; }
-
-  void * accelSrc = platform->allocAccelBuffer(bufsize);
-  platform->copyBufferHostToAccel(hostSrc, accelSrc, bufsize);
-
-  void * accelDst = platform->allocAccelBuffer(bufsize);
-
-  t.set_srcAddr((AccelDblReg) accelSrc);
-  t.set_dstAddr((AccelDblReg) accelDst);
-  t.set_byteCount(bufsize);
-
-  t.set_start(1);
-
-  while(t.get_finished() != 1);
-
   uint64_t * hostDst = new uint64_t[ub];
-  platform->copyBufferAccelToHost(accelDst, hostDst, bufsize);
-
-  t.set_start(0);
+  uint64_t bufsize = ub * sizeof(uint64_t);
 
-  platform->deallocAccelBuffer(accelSrc);
-  platform->deallocAccelBuffer(accelDst);
+  for(uint64_t i = 0; i < ub; i++) { hostSrc[i] = i+1; }
 
-  int res = memcmp(hostSrc, hostDst, bufsize);
+  BenchSample s;
+  s.cycles = 0;
+  s.waitUs = 0;
+
+  // stream the copy through accel memory in chunks, so that the input can be
+  // larger than the accel memory and transfers overlap with the accelerator
+  StreamRunner runner(platform, chunkBytes);
+  runner.run(hostSrc, hostDst, bufsize,
+    [&](void * accelSrc, void * accelDst, uint64_t numBytes, uint64_t chunkInd) {
+      // program all registers and start the accelerator in one batch
+      TestCopy::Config cfg;
+      cfg.srcAddr = (AccelDblReg) accelSrc;
+      cfg.dstAddr = (AccelDblReg) accelDst;
+      cfg.byteCount = numBytes;
+      cfg.start = 1;
+      t.configure(cfg);
+      t.wait_finished(1);
+      s.cycles += t.get_cycleCount();
+      s.waitUs += platform->getLastWaitTimeUs();
+      t.set_start(0);
+    }
+  );
+
+  s.ok = (memcmp(hostSrc, hostDst, bufsize) == 0);
+  // read and written
+  s.bytes = 2 * bufsize;
+  s.words = ub;
 
   delete [] hostSrc;
   delete [] hostDst;
 
-  cout << "memcmp result: " << res << endl;
-
-  return res == 0;
+  return s;
 }
 
-int main()
+int main(int argc, char ** argv)
 {
-  WrapperRegDriver * platform = initPlatform();
+  BenchArgs args(argc, argv,
+    "  --words LIST   number of 64-bit words to copy (default 1K:1M)\n"
+    "  --chunk N      accel buffer bytes per chunk of the copy (default 16M)\n");
+  vector<uint64_t> words = args.getList("words", "1K:1M");
+  // two input and two output buffers of this size
+  uint64_t chunkBytes = args.getUInt("chunk", 16 * 1024 * 1024);
+  Benchmark bench("TestCopy", args);
+  args.finish();
 
-  Run_TestCopy(platform);
+  WrapperRegDriver * platform = initPlatform();
+  {
+    TestCopy t(platform);
+    cerr << "Signature: " << hex << t.get_signature() << dec << endl;
+  }
+
+  for(unsigned int i = 0; i < words.size(); i++) {
+    uint64_t ub = words[i];
+    bench.run({{"words", ub}, {"chunk", chunkBytes}},
+      [&]() { return Run_TestCopy(platform, ub, chunkBytes); });
+  }
+  bench.report();
 
   deinitPlatform(platform);
 
-  return 0;
+  return bench.allOK() ? 0 : 1;
 }
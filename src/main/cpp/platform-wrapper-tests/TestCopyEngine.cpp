@@ -0,0 +1,118 @@
+#include <iostream>
+#include <chrono>
+using namespace std;
+#include <string.h>
+#include "platform.h"
+#include "copyengine.hpp"
+#include "benchmark.hpp"
+
+// host-side micro-benchmark: copy throughput of plain memcpy vs. CopyEngine,
+// into accelerator memory if the platform exposes it to the host and into
+// regular host memory otherwise, and of the driver copies in both
+// directions. no accelerator is needed. the time spent in the copy itself
+// is reported as wait_us, so host_gbps is the copy throughput.
+
+enum CopyMethod {
+	methodMemcpy, methodWideCopy, methodCopyEngine, methodHostToAccel, methodAccelToHost,
+	numMethods
+};
+
+// pattern that differs between repetitions, so a copy that did not happen
+// does not pass as correct
+void fillPattern(uint8_t * buf, uint64_t bytes, unsigned int seed) {
+	for(uint64_t i = 0; i < bytes; i++) { buf[i] = (uint8_t) (i * 7 + seed); }
+}
+
+uint64_t elapsedUs(chrono::steady_clock::time_point start) {
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+}
+
+BenchSample Run_TestCopyEngine(WrapperRegDriver * platform, CopyEngine & ce, unsigned int method,
+	uint64_t bufsize, unsigned int seed) {
+	uint8_t * hostSrc = new uint8_t[bufsize];
+	uint8_t * hostDst = new uint8_t[bufsize];
+	fillPattern(hostSrc, bufsize, seed);
+	memset(hostDst, 0, bufsize);
+
+	void * accelBuf = platform->allocAccelBuffer(bufsize);
+	uint8_t * accelPtr = (uint8_t *) platform->getHostPointer(accelBuf);
+	// the host-side copies go into accel memory if it is visible
+	uint8_t * dst = accelPtr ? accelPtr : hostDst;
+	bool uncachedDst = (accelPtr != 0);
+	if(method == methodAccelToHost)
+		platform->copyBufferHostToAccel(hostSrc, accelBuf, bufsize);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	switch(method) {
+		case methodMemcpy: memcpy(dst, hostSrc, bufsize); break;
+		case methodWideCopy: CopyEngine::wideCopy(dst, hostSrc, bufsize, uncachedDst); break;
+		case methodCopyEngine: ce.copy(dst, hostSrc, bufsize, uncachedDst); break;
+		case methodHostToAccel: platform->copyBufferHostToAccel(hostSrc, accelBuf, bufsize); break;
+		default: platform->copyBufferAccelToHost(accelBuf, hostDst, bufsize); break;
+	}
+	uint64_t copyUs = elapsedUs(start);
+
+	// check what arrived at the destination
+	bool ok;
+	if(method == methodHostToAccel) {
+		platform->copyBufferAccelToHost(accelBuf, hostDst, bufsize);
+		ok = (memcmp(hostDst, hostSrc, bufsize) == 0);
+	} else if(method == methodAccelToHost) {
+		ok = (memcmp(hostDst, hostSrc, bufsize) == 0);
+	} else {
+		ok = (memcmp(dst, hostSrc, bufsize) == 0);
+	}
+
+	platform->deallocAccelBuffer(accelBuf);
+	delete [] hostSrc;
+	delete [] hostDst;
+
+	BenchSample s;
+	s.bytes = bufsize;
+	s.words = bufsize;
+	s.cycles = 0;
+	s.waitUs = copyUs;
+	s.ok = ok;
+	return s;
+}
+
+int main(int argc, char ** argv)
+{
+	BenchArgs args(argc, argv,
+		"  --size LIST      bytes per copy (default 1M:64M)\n"
+		"  --method LIST    0 memcpy, 1 wide copy, 2 CopyEngine, 3 copyBufferHostToAccel,\n"
+		"                   4 copyBufferAccelToHost (default 0:4:1)\n"
+		"  --threads N      CopyEngine threads, 0 for one per core (default 0)\n");
+	vector<uint64_t> sizes = args.getList("size", "1M:64M");
+	vector<uint64_t> methods = args.getList("method", "0:4:1");
+	unsigned int numThreads = args.getUInt("threads", 0);
+	Benchmark bench("TestCopyEngine", args);
+	for(unsigned int i = 0; i < methods.size(); i++)
+		if(methods[i] >= numMethods) args.fail("--method values must be in 0..4");
+	args.finish();
+
+	WrapperRegDriver * platform = initPlatform();
+	CopyEngine ce(numThreads);
+	{
+		void * probe = platform->allocAccelBuffer(64);
+		bool hostVisible = (platform->getHostPointer(probe) != 0);
+		platform->deallocAccelBuffer(probe);
+		cerr << "Host-side copies into " << (hostVisible ? "accel memory" : "host memory");
+		cerr << ", CopyEngine threads: " << ce.getNumThreads() << endl;
+	}
+
+	unsigned int seed = 0;
+	for(unsigned int m = 0; m < methods.size(); m++) {
+		for(unsigned int i = 0; i < sizes.size(); i++) {
+			unsigned int method = methods[m];
+			uint64_t bytes = sizes[i];
+			bench.run({{"method", method}, {"size", bytes}},
+				[&]() { return Run_TestCopyEngine(platform, ce, method, bytes, ++seed); });
+		}
+	}
+	bench.report();
+
+	deinitPlatform(platform);
+
+	return bench.allOK() ? 0 : 1;
+}
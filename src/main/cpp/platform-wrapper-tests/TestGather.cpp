@@ -1,41 +1,30 @@
 #include <iostream>
 #include <stdint.h>
 #include <string>
-#include <stdio.h>
 using namespace std;
 
 #include "TestGather.hpp"
 #include "platform.h"
+#include "benchmark.hpp"
 
 typedef uint64_t AccelWord;
 typedef uint32_t RandAccInd;
 
-RandAccInd * readInfData(std::string fileName, unsigned int & numInds) {
-  FILE *f = fopen(fileName.c_str(), "rb");
-  if(!f) throw (std::string("Could not open file: ") + fileName).c_str();
-  fseek(f, 0, SEEK_END);
-  unsigned int fsize = ftell(f);
-  fseek(f, 0, SEEK_SET);
-
-  numInds = fsize / sizeof(RandAccInd);
-
-  RandAccInd * buf = new RandAccInd[numInds];
-  unsigned int r = fread((void *) buf, 1, fsize, f);
-
-  if(r != fsize) throw "Read error";
-
-  fclose(f);
-
-  return buf;
+// fetches the perf counters with a single status block write by the
+// accelerator, instead of reading their registers
+bool readPerfBlock(TestGather & t, void * accelBufBlock, TestGather::PerfBlock & block) {
+  AccelReg written = t.get_statusBlock_blocksWritten();
+  t.set_statusBlock_trigger(1);
+  bool ok = t.wait_statusBlock_blocksWritten(written + 1, 1000000);
+  t.set_statusBlock_trigger(0);
+  return ok && t.readPerfBlock(accelBufBlock, block);
 }
 
-bool Run_TestGather(WrapperRegDriver * platform) {
+BenchSample Run_TestGather(WrapperRegDriver * platform, unsigned int numVals,
+  const string & indsFileName, const string & perfFileName, bool usePerfBlock) {
   TestGather t(platform);
 
-  cout << "Signature: " << hex << t.get_signature() << dec << endl;
-  unsigned int numVals, numInds;
-  cout << "Number of values to generate: ";
-  cin >> numVals;
+  unsigned int numInds;
 
   // allocate memory and generate indices with predictable structure
   AccelWord * hostBufVal = new AccelWord[numVals];
@@ -48,60 +37,102 @@ bool Run_TestGather(WrapperRegDriver * platform) {
   t.set_valsBase((AccelDblReg) accelBufVal);
 
   // read random access indices from a file and copy into accel memory
-  cout << "Enter filename to get rand.acc. indices (or eye): ";
-  string indsFileName;
-  cin >> indsFileName;
-
-  RandAccInd * hostBufInds;
+  void * accelBufInds;
+  uint64_t indsbufsize;
   if(indsFileName == "eye") {
     numInds = numVals;
-    hostBufInds = new RandAccInd[numInds];
+    RandAccInd * hostBufInds = new RandAccInd[numInds];
     for(unsigned int i = 0; i < numInds; i++) { hostBufInds[i] = i; }
+    indsbufsize = numInds * sizeof(RandAccInd);
+    accelBufInds = platform->allocAccelBuffer(indsbufsize);
+    platform->copyBufferHostToAccel(hostBufInds, accelBufInds, indsbufsize);
+    delete [] hostBufInds;
   } else {
-    hostBufInds = readInfData(indsFileName, numInds);
+    // load the index file straight into accel memory
+    indsbufsize = MappedFile::sizeOf(indsFileName.c_str());
+    numInds = indsbufsize / sizeof(RandAccInd);
+    accelBufInds = platform->allocAccelBuffer(indsbufsize);
+    platform->loadFileToAccel(indsFileName.c_str(), accelBufInds);
   }
 
-  unsigned int indsbufsize = numInds * sizeof(RandAccInd);
-
-  void * accelBufInds = platform->allocAccelBuffer(indsbufsize);
-  platform->copyBufferHostToAccel(hostBufInds, accelBufInds, indsbufsize);
-
   t.set_indsBase((AccelDblReg) accelBufInds);
   t.set_count((AccelReg) numInds);
 
-  cout << "Starting accelerator..." << endl;
-
   t.set_start(1);
 
-  while(t.get_finished() != 1);
-
-  cout << "Passed: " << t.get_resultsOK() << endl;
-  cout << "Failed: " << t.get_resultsNotOK() << endl;
+  // sample the performance counters every millisecond while waiting
+  PerfSeries perfSeries = t.makePerfSeries();
+  t.samplePerf(perfSeries);
+  while(!t.wait_finished(1, 1000))
+    t.samplePerf(perfSeries);
+  t.samplePerf(perfSeries);
+
+  BenchSample s;
+  s.bytes = indsbufsize + (uint64_t) numInds * sizeof(AccelWord);
+  s.words = numInds;
+  s.cycles = t.get_perf_cycles();
+  bool perfBlockOK = true;
+  if(usePerfBlock) {
+    TestGather::PerfBlock block;
+    void * accelBufBlock = platform->allocAccelBuffer(sizeof(block));
+    t.set_statusBlock_baseAddr((AccelDblReg) accelBufBlock);
+    if(!readPerfBlock(t, accelBufBlock, block) || block.cycles != s.cycles) {
+      cerr << "Perf status block does not match the perf registers" << endl;
+      perfBlockOK = false;
+    }
+    t.set_statusBlock_baseAddr(0);
+    platform->deallocAccelBuffer(accelBufBlock);
+  }
+  s.waitUs = perfSeries[perfSeries.size() - 1].timestampUs - perfSeries[0].timestampUs;
+  s.ok = perfBlockOK && (t.get_resultsOK() == numInds) && (t.get_resultsNotOK() == 0);
 
-  // display performance counters
-  cout << endl << "Performance counters: " << endl << "=====================" << endl;
-  map<string, vector<unsigned int>> regMap = t.getStatusRegs();
-  string prefix = "perf_";
+  if(!s.ok)
+    cerr << "Passed: " << t.get_resultsOK() << " failed: " << t.get_resultsNotOK() << endl;
 
-  for(auto & keyVal : regMap) {
-    if(keyVal.first.substr(0, prefix.size()) == prefix)
-      cout << keyVal.first << " : " << t.readStatusReg(keyVal.first) << endl;
-  }
+  // the series of the last run is kept
+  if(!perfFileName.empty())
+    perfSeries.save(perfFileName.c_str());
 
   t.set_start(0);
 
   platform->deallocAccelBuffer(accelBufInds);
   platform->deallocAccelBuffer(accelBufVal);
   delete [] hostBufVal;
-  delete [] hostBufInds;
 
-  return true;
+  return s;
 }
 
-int main()
+int main(int argc, char ** argv)
 {
+  BenchArgs args(argc, argv,
+    "  --vals LIST      number of values to generate (default 64K)\n"
+    "  --inds FILE      file with 32-bit random access indices, or eye for\n"
+    "                   the identity (default eye)\n"
+    "  --perf-out FILE  perf counter series of the last run, CSV or .json\n"
+    "                   (default TestGather-perf.csv, empty to disable)\n"
+    "  --perf-block N   1 to also fetch the perf counters as a status block\n"
+    "                   and check them against the registers (default 0)\n");
+  vector<uint64_t> vals = args.getList("vals", "64K");
+  string indsFileName = args.getString("inds", "eye");
+  string perfFileName = args.getString("perf-out", "TestGather-perf.csv");
+  bool usePerfBlock = args.getUInt("perf-block", 0);
+  Benchmark bench("TestGather", args);
+  args.finish();
+
   WrapperRegDriver * platform = initPlatform();
-  Run_TestGather(platform);
+  {
+    TestGather t(platform);
+    cerr << "Signature: " << hex << t.get_signature() << dec << endl;
+  }
+
+  for(unsigned int i = 0; i < vals.size(); i++) {
+    unsigned int numVals = vals[i];
+    bench.run({{"vals", numVals}},
+      [&]() { return Run_TestGather(platform, numVals, indsFileName, perfFileName, usePerfBlock); });
+  }
+  bench.report();
+
   deinitPlatform(platform);
-  return 0;
+
+  return bench.allOK() ? 0 : 1;
 }
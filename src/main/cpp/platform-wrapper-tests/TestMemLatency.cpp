@@ -4,6 +4,7 @@ using namespace std;
 
 #include "TestMemLatency.hpp"
 #include "platform.h"
+#include "benchmark.hpp"
 
 // issue a number of 8-beat bursts, with a parametrizable number of outstanding
 // memory requests. the memory latency can be estimated from the number of
@@ -13,64 +14,75 @@ using namespace std;
 // be used to estimate the average latency as L = OMR * 8
 // (since the accelerator uses 8-beat bursts)
 
-bool Run_TestMemLatency(WrapperRegDriver * platform) {
+BenchSample Run_TestMemLatency(WrapperRegDriver * platform, unsigned int omr, unsigned int ub) {
 	TestMemLatency t(platform);
 
-	cout << "Signature: " << hex << t.get_signature() << dec << endl;
+	typedef uint64_t AccelWord;
+	AccelWord * hostBuf = new AccelWord[ub];
+	unsigned int bufsize = ub * sizeof(AccelWord);
+	// the sum register is 32 bits wide, compute in 64 bits and truncate
+	uint32_t golden = (uint32_t) ((uint64_t) ub * (ub + 1) / 2);
 
-	while(1) {
-		unsigned int omr = 16;
-		cout << "Enter # of outstanding mem requests (max 16, 0 to exit):" << endl;
-		cin >> omr;
+	for(unsigned int i = 0; i < ub; i++) { hostBuf[i] = i+1; }
 
-		if(omr == 0) break;
+	void * accelBuf = platform->allocAccelBuffer(bufsize);
+	platform->copyBufferHostToAccel(hostBuf, accelBuf, bufsize);
 
-		unsigned int ub = 0;
-		cout << "Enter upper bound of sum (divisable by 8): " << endl;
-		cin >> ub;
+	t.set_baseAddr((AccelDblReg) accelBuf);
+	t.set_byteCount(bufsize);
 
-		typedef uint64_t AccelWord;
-		AccelWord * hostBuf = new AccelWord[ub];
-		unsigned int bufsize = ub * sizeof(AccelWord);
-		unsigned int golden = (ub*(ub+1))/2;
+	// set # outstanding mem requests and pulse doInit to reinitialize pool
+	t.set_initCount(omr);
+	t.set_doInit(1);
+	t.set_doInit(0);
 
-		for(unsigned int i = 0; i < ub; i++) { hostBuf[i] = i+1; }
+	t.set_start(1);
 
-		void * accelBuf = platform->allocAccelBuffer(bufsize);
-		platform->copyBufferHostToAccel(hostBuf, accelBuf, bufsize);
+	t.wait_finished(1);
 
-		t.set_baseAddr((AccelDblReg) accelBuf);
-		t.set_byteCount(bufsize);
+	platform->deallocAccelBuffer(accelBuf);
+	delete [] hostBuf;
 
-		// set # outstanding mem requests and pulse doInit to reinitialize pool
-		t.set_initCount(omr);
-		t.set_doInit(1);
-		t.set_doInit(0);
-
-		t.set_start(1);
-
-		while(t.get_finished() != 1);
-
-		platform->deallocAccelBuffer(accelBuf);
-		delete [] hostBuf;
-
-		AccelReg res = t.get_sum();
-		cout << "Result = " << res << " expected " << golden << endl;
-		unsigned int cc = t.get_cycleCount();
-		cout << "#cycles = " << cc << " cycles per word = " << (float)cc/(float)ub << endl;
-		t.set_start(0);
-	}
-
-	return true;
+	BenchSample s;
+	s.bytes = bufsize;
+	s.words = ub;
+	s.cycles = t.get_cycleCount();
+	s.waitUs = platform->getLastWaitTimeUs();
+	s.ok = (t.get_sum() == golden);
+	t.set_start(0);
+	return s;
 }
 
-int main()
+int main(int argc, char ** argv)
 {
+	BenchArgs args(argc, argv,
+		"  --omr LIST     outstanding mem requests, max 16 (default 1:16)\n"
+		"  --words LIST   number of 64-bit words to sum, multiple of 8 (default 64K)\n");
+	vector<uint64_t> omrs = args.getList("omr", "1:16");
+	vector<uint64_t> words = args.getList("words", "64K");
+	Benchmark bench("TestMemLatency", args);
+	for(unsigned int i = 0; i < omrs.size(); i++)
+		if(omrs[i] == 0 || omrs[i] > 16) args.fail("--omr values must be in 1..16");
+	for(unsigned int i = 0; i < words.size(); i++)
+		if(words[i] % 8 != 0) args.fail("--words values must be divisible by 8");
+	args.finish();
+
 	WrapperRegDriver * platform = initPlatform();
+	{
+		TestMemLatency t(platform);
+		cerr << "Signature: " << hex << t.get_signature() << dec << endl;
+	}
 
-	Run_TestMemLatency(platform);
+	for(unsigned int w = 0; w < words.size(); w++) {
+		for(unsigned int o = 0; o < omrs.size(); o++) {
+			unsigned int ub = words[w], omr = omrs[o];
+			bench.run({{"words", ub}, {"omr", omr}},
+				[&]() { return Run_TestMemLatency(platform, omr, ub); });
+		}
+	}
+	bench.report();
 
 	deinitPlatform(platform);
 
-	return 0;
+	return bench.allOK() ? 0 : 1;
 }
@@ -1,60 +1,125 @@
 #include <iostream>
+#include <chrono>
 using namespace std;
 
 #include "TestMultiChanSum.hpp"
 #include "platform.h"
+#include "threadsaferegdriver.hpp"
+#include "channelscheduler.hpp"
+#include "benchmark.hpp"
+
+// start the job on the given channel and wait for it to finish, returns the
+// sum and adds the channel's cycle count to cycles
+AccelReg runOnChannel(TestMultiChanSum & t, unsigned int chan, void * accBuf, unsigned int bufsize, uint64_t & cycles) {
+	if(chan == 0) {
+		t.set_byteCount_0(bufsize); t.set_baseAddr_0((AccelDblReg) accBuf);
+		t.set_start_0(1);
+		t.wait_finished_0(1);
+		AccelReg res = t.get_sum_0();
+		cycles += t.get_cycleCount_0();
+		t.set_start_0(0);
+		return res;
+	} else {
+		t.set_byteCount_1(bufsize); t.set_baseAddr_1((AccelDblReg) accBuf);
+		t.set_start_1(1);
+		t.wait_finished_1(1);
+		AccelReg res = t.get_sum_1();
+		cycles += t.get_cycleCount_1();
+		t.set_start_1(0);
+		return res;
+	}
+}
 
-bool Run_TestMultiChanSum(WrapperRegDriver * platform) {
-	TestMultiChanSum t(platform);
-
-	cout << "Signature: " << hex << t.get_signature() << dec << endl;
-	unsigned int ub = 0, offs = 0;
-	cout << "Enter upper bound of sum and channel 1 const offset: " << endl;
-	cin >> ub >> offs;
+BenchSample Run_TestMultiChanSum(ThreadSafeRegDriver & tsPlatform, unsigned int ub, unsigned int offs,
+	unsigned int numJobs, unsigned int numChans) {
+	TestMultiChanSum t(&tsPlatform);
 
-	unsigned int * hostBuf0 = new unsigned int[ub];
-	unsigned int * hostBuf1 = new unsigned int[ub];
 	unsigned int bufsize = ub * sizeof(unsigned int);
-
-	for(unsigned int i = 0; i < ub; i++) {hostBuf0[i] = i+1; hostBuf1[i] = i+1 + offs;}
-
-	void * accBuf0 = platform->allocAccelBuffer(bufsize);
-	void * accBuf1 = platform->allocAccelBuffer(bufsize);
-
-	platform->copyBufferHostToAccel((void *) hostBuf0, accBuf0, bufsize);
-	platform->copyBufferHostToAccel((void *) hostBuf1, accBuf1, bufsize);
-
-	t.set_byteCount_0(bufsize);  t.set_byteCount_1(bufsize);
-	t.set_baseAddr_0((AccelDblReg) accBuf0); t.set_baseAddr_1((AccelDblReg) accBuf1);
-
-	t.set_start(1);
-
-	while(t.get_status() != 1);
-
-	unsigned int res0 = t.get_sum_0();	unsigned int res1 = t.get_sum_1();
-	unsigned int exp0 = (ub*(ub+1))/2; unsigned int exp1 = exp0 + ub*offs;
-
-	t.set_start(0);
-
-	cout << "Chan 0 sum = " << res0 << " expected = " << exp0 << endl;
-	cout << "Chan 1 sum = " << res1 << " expected = " << exp1 << endl;
-
-	platform->deallocAccelBuffer(accBuf0);
-	platform->deallocAccelBuffer(accBuf1);
-
-	delete [] hostBuf0;
-	delete [] hostBuf1;
-
-	return (res0 == exp0) && (res1 == exp1);
+	unsigned int * hostBuf = new unsigned int[ub];
+	vector<void *> accBuf(numJobs);
+	vector<unsigned int> res(numJobs), exp(numJobs);
+	vector<uint64_t> cycles(numJobs, 0);
+
+	for(unsigned int j = 0; j < numJobs; j++) {
+		for(unsigned int i = 0; i < ub; i++) hostBuf[i] = i+1 + j*offs;
+		accBuf[j] = tsPlatform.allocAccelBuffer(bufsize);
+		tsPlatform.copyBufferHostToAccel((void *) hostBuf, accBuf[j], bufsize);
+		// the sum registers are 32 bits wide, compute in 64 bits and truncate
+		exp[j] = (uint32_t) ((uint64_t) ub * (ub + 1) / 2 + (uint64_t) ub * offs * j);
+	}
+
+	// each job runs on whichever channel frees up first. the wait time is
+	// from submitting the first job until all are done.
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	{
+		ChannelScheduler sched(numChans);
+		vector<future<void> > done;
+		for(unsigned int j = 0; j < numJobs; j++) {
+			done.push_back(sched.submit([&, j](unsigned int chan) {
+				res[j] = runOnChannel(t, chan, accBuf[j], bufsize, cycles[j]);
+			}));
+		}
+		for(unsigned int j = 0; j < numJobs; j++)
+			done[j].get();
+	}
+	chrono::steady_clock::time_point end = chrono::steady_clock::now();
+
+	BenchSample s;
+	s.bytes = (uint64_t) numJobs * bufsize;
+	s.words = (uint64_t) numJobs * ub;
+	// busy cycles summed over the channels, not elapsed cycles
+	s.cycles = 0;
+	s.waitUs = chrono::duration_cast<chrono::microseconds>(end - start).count();
+	s.ok = true;
+	for(unsigned int j = 0; j < numJobs; j++) {
+		if(res[j] != exp[j])
+			cerr << "Job " << j << " sum = " << res[j] << " expected = " << exp[j] << endl;
+		s.ok = s.ok && (res[j] == exp[j]);
+		s.cycles += cycles[j];
+		tsPlatform.deallocAccelBuffer(accBuf[j]);
+	}
+
+	delete [] hostBuf;
+
+	return s;
 }
 
-int main()
+int main(int argc, char ** argv)
 {
-	WrapperRegDriver * platform = initPlatform();
+	BenchArgs args(argc, argv,
+		"  --words LIST      number of 32-bit words to sum per job (default 1K:64K)\n"
+		"  --jobs LIST       number of independent sum jobs (default 4)\n"
+		"  --channels LIST   accelerator channels to use, 1 or 2 (default 1:2)\n"
+		"  --offset N        per-job constant added to the inputs (default 1)\n");
+	vector<uint64_t> words = args.getList("words", "1K:64K");
+	vector<uint64_t> jobs = args.getList("jobs", "4");
+	vector<uint64_t> chans = args.getList("channels", "1:2");
+	unsigned int offs = args.getUInt("offset", 1);
+	Benchmark bench("TestMultiChanSum", args);
+	for(unsigned int i = 0; i < chans.size(); i++)
+		if(chans[i] == 0 || chans[i] > 2) args.fail("--channels values must be 1 or 2");
+	args.finish();
 
-	Run_TestMultiChanSum(platform);
+	WrapperRegDriver * platform = initPlatform();
+	{
+		// the channels are driven from separate host threads
+		ThreadSafeRegDriver tsPlatform(platform);
+		{
+			TestMultiChanSum t(&tsPlatform);
+			cerr << "Signature: " << hex << t.get_signature() << dec << endl;
+		}
+
+		for(unsigned int w = 0; w < words.size(); w++)
+			for(unsigned int j = 0; j < jobs.size(); j++)
+				for(unsigned int c = 0; c < chans.size(); c++) {
+					unsigned int ub = words[w], numJobs = jobs[j], numChans = chans[c];
+					bench.run({{"words", ub}, {"jobs", numJobs}, {"channels", numChans}},
+						[&]() { return Run_TestMultiChanSum(tsPlatform, ub, offs, numJobs, numChans); });
+				}
+		bench.report();
+	}
 
 	deinitPlatform(platform);
 
-	return 0;
+	return bench.allOK() ? 0 : 1;
 }
@@ -3,14 +3,10 @@ using namespace std;
 #include <string.h>
 #include "TestSeqWrite.hpp"
 #include "platform.h"
+#include "benchmark.hpp"
 
-bool Run_TestSeqWrite(WrapperRegDriver * platform) {
+BenchSample Run_TestSeqWrite(WrapperRegDriver * platform, unsigned int init, unsigned int step, unsigned int count) {
   TestSeqWrite t(platform);
-  cout << "TestSeqWrite test" << endl;
-  cout << "Signature: " << hex << t.get_signature() << dec << endl;
-  unsigned int init, step, count;
-  cout << "Enter init, step and count: " << endl;
-  cin >> init >> step >> count;
 
   uint64_t * hostSrc = new uint64_t[count];
   unsigned int bufsize = count * sizeof(uint64_t);
@@ -19,14 +15,22 @@ bool Run_TestSeqWrite(WrapperRegDriver * platform) {
 
   void * accelSrc = platform->allocAccelBuffer(bufsize);
 
-  t.set_init(init);
-  t.set_step(step);
-  t.set_count(count);
-  t.set_baseAddr((AccelDblReg) accelSrc);
+  // program all registers and start the accelerator in one batch
+  TestSeqWrite::Config cfg;
+  cfg.init = init;
+  cfg.step = step;
+  cfg.count = count;
+  cfg.baseAddr = (AccelDblReg) accelSrc;
+  cfg.start = 1;
+  t.configure(cfg);
 
+  t.wait_finished(1);
 
-  t.set_start(1);
-  while(t.get_finished() != 1);
+  BenchSample s;
+  s.bytes = bufsize;
+  s.words = count;
+  s.cycles = t.get_cycleCount();
+  s.waitUs = platform->getLastWaitTimeUs();
 
   uint64_t * hostDst = new uint64_t[count];
   platform->copyBufferAccelToHost(accelSrc, hostDst, bufsize);
@@ -35,28 +39,46 @@ bool Run_TestSeqWrite(WrapperRegDriver * platform) {
 
   platform->deallocAccelBuffer(accelSrc);
 
-  int res = memcmp(hostSrc, hostDst, bufsize);
+  s.ok = (memcmp(hostSrc, hostDst, bufsize) == 0);
 
-  if(res != 0)
+  if(!s.ok)
     for(uint64_t i = 0; i < count; i++) {
-      cout << i << " " << hostSrc[i] << " " << hostDst[i] << endl;
+      if(hostSrc[i] != hostDst[i])
+        cerr << i << " " << hostSrc[i] << " " << hostDst[i] << endl;
     }
 
   delete [] hostSrc;
   delete [] hostDst;
 
-  cout << "memcmp result: " << res << endl;
-
-  return res == 0;
+  return s;
 }
 
-int main()
+int main(int argc, char ** argv)
 {
-  WrapperRegDriver * platform = initPlatform();
+  BenchArgs args(argc, argv,
+    "  --count LIST   number of 64-bit words to write (default 1K:1M)\n"
+    "  --init N       first value of the sequence (default 1)\n"
+    "  --step N       sequence increment (default 1)\n");
+  vector<uint64_t> counts = args.getList("count", "1K:1M");
+  unsigned int init = args.getUInt("init", 1);
+  unsigned int step = args.getUInt("step", 1);
+  Benchmark bench("TestSeqWrite", args);
+  args.finish();
 
-  Run_TestSeqWrite(platform);
+  WrapperRegDriver * platform = initPlatform();
+  {
+    TestSeqWrite t(platform);
+    cerr << "Signature: " << hex << t.get_signature() << dec << endl;
+  }
+
+  for(unsigned int i = 0; i < counts.size(); i++) {
+    unsigned int count = counts[i];
+    bench.run({{"count", count}},
+      [&]() { return Run_TestSeqWrite(platform, init, step, count); });
+  }
+  bench.report();
 
   deinitPlatform(platform);
 
-  return 0;
+  return bench.allOK() ? 0 : 1;
 }
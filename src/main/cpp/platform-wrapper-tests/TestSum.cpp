@@ -3,49 +3,79 @@ using namespace std;
 
 #include "TestSum.hpp"
 #include "platform.h"
+#include "benchmark.hpp"
+#include "shadowregdriver.hpp"
 
-bool Run_TestSum(WrapperRegDriver * platform) {
+BenchSample Run_TestSum(WrapperRegDriver * platform, unsigned int ub) {
 	TestSum t(platform);
 
-	cout << "Signature: " << hex << t.get_signature() << dec << endl;
-	unsigned int ub = 0;
-	cout << "Enter upper bound of sum: " << endl;
-	cin >> ub;
-
-	unsigned int * hostBuf = new unsigned int[ub];
 	unsigned int bufsize = ub * sizeof(unsigned int);
-	unsigned int golden = (ub*(ub+1))/2;
+	// the sum register is 32 bits wide, compute in 64 bits and truncate
+	uint32_t golden = (uint32_t) ((uint64_t) ub * (ub + 1) / 2);
+
+	// generate the input directly in accelerator memory if the platform
+	// allows it, otherwise stage it in a host buffer and copy it over
+	void * accelBuf = platform->allocAccelBuffer(bufsize);
+	unsigned int * hostBuf = (unsigned int *) platform->getHostPointer(accelBuf);
+	bool zeroCopy = (hostBuf != 0);
+	if(!zeroCopy) hostBuf = new unsigned int[ub];
 
 	for(unsigned int i = 0; i < ub; i++) { hostBuf[i] = i+1; }
 
-	void * accelBuf = platform->allocAccelBuffer(bufsize);
-	platform->copyBufferHostToAccel(hostBuf, accelBuf, bufsize);
+	if(zeroCopy) platform->syncBufferForAccel(accelBuf, bufsize);
+	else platform->copyBufferHostToAccel(hostBuf, accelBuf, bufsize);
 
 	t.set_baseAddr((AccelDblReg) accelBuf);
 	t.set_byteCount(bufsize);
 
 	t.set_start(1);
 
-	while(t.get_finished() != 1);
+	t.wait_finished(1);
 
 	platform->deallocAccelBuffer(accelBuf);
-	delete [] hostBuf;
+	if(!zeroCopy) delete [] hostBuf;
 
-	AccelReg res = t.get_sum();
-	cout << "Result = " << res << " expected " << golden << endl;
-	unsigned int cc = t.get_cycleCount();
-	cout << "#cycles = " << cc << " cycles per word = " << (float)cc/(float)ub << endl;
+	BenchSample s;
+	s.bytes = bufsize;
+	s.words = ub;
+	s.cycles = t.get_cycleCount();
+	s.waitUs = platform->getLastWaitTimeUs();
+	s.ok = (t.get_sum() == golden);
 	t.set_start(0);
-	return res == golden;
+	return s;
 }
 
-int main()
+int main(int argc, char ** argv)
 {
-	WrapperRegDriver * platform = initPlatform();
+	BenchArgs args(argc, argv,
+		"  --words LIST   number of 32-bit words to sum (default 1K:64K)\n"
+		"  --shadow N     1 to elide redundant register writes (default 0)\n");
+	vector<uint64_t> words = args.getList("words", "1K:64K");
+	bool useShadow = args.getUInt("shadow", 0);
+	Benchmark bench("TestSum", args);
+	args.finish();
+
+	WrapperRegDriver * basePlatform = initPlatform();
+	{
+		// the shadow driver commits on destruction, so it must be gone
+		// before the platform driver is
+		ShadowRegDriver shadow(basePlatform);
+		WrapperRegDriver * platform = useShadow ? &shadow : basePlatform;
+		{
+			TestSum t(platform);
+			cerr << "Signature: " << hex << t.get_signature() << dec << endl;
+		}
 
-	Run_TestSum(platform);
+		for(unsigned int i = 0; i < words.size(); i++) {
+			unsigned int ub = words[i];
+			bench.run({{"words", ub}}, [&]() { return Run_TestSum(platform, ub); });
+		}
+		bench.report();
+		if(useShadow)
+			cerr << "Register writes elided: " << shadow.getElidedWrites() << " issued: " << shadow.getIssuedWrites() << endl;
+	}
 
-	deinitPlatform(platform);
+	deinitPlatform(basePlatform);
 
-	return 0;
+	return bench.allOK() ? 0 : 1;
 }
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+#include "TestSum.hpp"
+#include "testerdriver.hpp"
+#include "sweeprunner.hpp"
+#include "benchmark.hpp"
+
+// emulator-only: sweeps TestSum over a range of input sizes, with one
+// emulator instance per host thread
+
+// one repetition of a sweep point, with its wall time
+struct SumRep {
+	BenchSample sample;
+	uint64_t wallUs;
+};
+
+SumRep Run_SumRep(WrapperRegDriver * platform, unsigned int ub) {
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	TestSum t(platform);
+	unsigned int bufsize = ub * sizeof(unsigned int);
+	unsigned int * hostBuf = new unsigned int[ub];
+	for(unsigned int i = 0; i < ub; i++) { hostBuf[i] = i+1; }
+
+	void * accelBuf = platform->allocAccelBuffer(bufsize);
+	platform->copyBufferHostToAccel(hostBuf, accelBuf, bufsize);
+	t.set_baseAddr((AccelDblReg) accelBuf);
+	t.set_byteCount(bufsize);
+	t.set_start(1);
+	t.wait_finished(1);
+
+	SumRep ret;
+	ret.sample.bytes = bufsize;
+	ret.sample.words = ub;
+	ret.sample.cycles = t.get_cycleCount();
+	ret.sample.waitUs = platform->getLastWaitTimeUs();
+	// the sum register is 32 bits wide, compute in 64 bits and truncate
+	ret.sample.ok = (t.get_sum() == (uint32_t) ((uint64_t) ub * (ub + 1) / 2));
+	t.set_start(0);
+
+	platform->deallocAccelBuffer(accelBuf);
+	delete [] hostBuf;
+	ret.wallUs = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+	return ret;
+}
+
+int main(int argc, char ** argv)
+{
+	BenchArgs args(argc, argv,
+		"  --words LIST   upper bounds of the sum (default 1K:64K:1K)\n"
+		"  --threads N    emulator threads, 0 for one per core (default 0)\n");
+	vector<uint64_t> ubs = args.getList("words", "1K:64K:1K");
+	unsigned int numThreads = args.getUInt("threads", 0);
+	Benchmark bench("TestSumSweep", args);
+	args.finish();
+
+	// all repetitions of all points run in parallel, then are reported per
+	// point in sweep order
+	unsigned int repsPerPoint = bench.getRepsPerPoint();
+	SweepRunner<SumRep> sweep([]() { return (WrapperRegDriver *) new TesterRegDriver(); }, numThreads);
+	cerr << "Running " << ubs.size() << " points on " << sweep.getNumThreads() << " threads" << endl;
+	vector<SumRep> res = sweep.run(ubs.size() * repsPerPoint, [&](WrapperRegDriver * platform, unsigned int i) {
+		return Run_SumRep(platform, ubs[i / repsPerPoint]);
+	});
+
+	for(unsigned int p = 0; p < ubs.size(); p++) {
+		vector<BenchSample> samples;
+		vector<uint64_t> wallUs;
+		for(unsigned int r = 0; r < repsPerPoint; r++) {
+			samples.push_back(res[p * repsPerPoint + r].sample);
+			wallUs.push_back(res[p * repsPerPoint + r].wallUs);
+		}
+		bench.add({{"words", ubs[p]}}, samples, wallUs);
+	}
+	bench.report();
+
+	return bench.allOK() ? 0 : 1;
+}
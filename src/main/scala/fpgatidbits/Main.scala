@@ -19,7 +19,7 @@ object TidbitsMakeUtils {
   val platformMap: PlatformMap = Map(
     "ZedBoard" -> {f => new ZedBoardWrapper(f)},
     "WX690T" -> {f => new WolverinePlatformWrapper(f)},
-    "Tester" -> {f => new TesterWrapper(f)}
+    "Tester" -> {f => new TesterWrapper(f, extMem = true)}
   )
 
   def fileCopy(from: String, to: String) = {
@@ -80,8 +80,8 @@ object TidbitsMakeUtils {
     chiselMain(chiselArgs, () => Module(platformInst(accInst)))
     val verilogBlackBoxFiles = Seq("Q_srl.v", "DualPortBRAM.v")
     val scriptFiles = Seq("verilator-build.sh")
-    val driverFiles = Seq("wrapperregdriver.h", "platform-verilatedtester.cpp",
-      "platform.h", "verilatedtesterdriver.hpp")
+    val p = platformInst(accInst)
+    val driverFiles = p.platformDriverFiles
 
     // copy blackbox verilog, scripts, driver and SW support files
     fileCopyBulk(s"$tidbitsDir/verilog/", destDir, verilogBlackBoxFiles)
@@ -89,7 +89,7 @@ object TidbitsMakeUtils {
     fileCopyBulk(s"$tidbitsDir/cpp/platform-wrapper-regdriver/", destDir,
       driverFiles)
     // build driver
-    platformInst(accInst).generateRegDriver(destDir)
+    p.generateRegDriver(destDir)
   }
 }
 
@@ -117,7 +117,7 @@ object MainObj {
   val platformMap: PlatformMap = Map(
     "ZedBoard" -> {f => new ZedBoardWrapper(f)},
     "WX690T" -> {f => new WolverinePlatformWrapper(f)},
-    "Tester" -> {f => new TesterWrapper(f)}
+    "Tester" -> {f => new TesterWrapper(f, extMem = true)}
   )
 
   def fileCopy(from: String, to: String) = {
@@ -150,12 +150,11 @@ object MainObj {
 
     chiselMain(chiselArgs, () => Module(platformInst(accInst)))
     // build driver
-    platformInst(accInst).generateRegDriver(s"$targetDir/")
+    val p = platformInst(accInst)
+    p.generateRegDriver(s"$targetDir/")
     // copy emulator driver and SW support files
     val regDrvRoot = "src/main/cpp/platform-wrapper-regdriver/"
-    val files = Array("wrapperregdriver.h", "platform-tester.cpp",
-      "platform.h", "testerdriver.hpp")
-    for(f <- files) { fileCopy(regDrvRoot + f, s"$targetDir/" + f) }
+    for(f <- p.platformDriverFiles) { fileCopy(regDrvRoot + f, s"$targetDir/" + f) }
     val testRoot = "src/main/cpp/platform-wrapper-tests/"
     fileCopy(testRoot + accelName + ".cpp", s"$targetDir/main.cpp")
   }
@@ -170,8 +169,8 @@ object MainObj {
     chiselMain(chiselArgs, () => Module(platformInst(accInst)))
     val verilogBlackBoxFiles = Seq("Q_srl.v", "DualPortBRAM.v")
     val scriptFiles = Seq("verilator-build.sh")
-    val driverFiles = Seq("wrapperregdriver.h", "platform-verilatedtester.cpp",
-      "platform.h", "verilatedtesterdriver.hpp")
+    val p = platformInst(accInst)
+    val driverFiles = p.platformDriverFiles
 
     // copy blackbox verilog, scripts, driver and SW support files
     fileCopyBulk("src/main/verilog/", "verilator/", verilogBlackBoxFiles)
@@ -179,7 +178,7 @@ object MainObj {
     fileCopyBulk("src/main/cpp/platform-wrapper-regdriver/", "verilator/",
       driverFiles)
     // build driver
-    platformInst(accInst).generateRegDriver("verilator/")
+    p.generateRegDriver("verilator/")
     // copy test application
     val testRoot = "src/main/cpp/platform-wrapper-tests/"
     fileCopy(testRoot + accelName + ".cpp", "verilator/main.cpp")
@@ -0,0 +1,135 @@
+package fpgatidbits.dma
+
+import Chisel._
+
+// writes packed snapshots of a set of status signals (performance counters
+// and such) to host memory, so that the host can collect all of them with a
+// single buffer read instead of one register access each.
+// the block is a sequence of 64-bit little-endian words:
+// - the sequence number of the snapshot, starting from 1
+// - each signal, in as many words as it needs (least significant first)
+// - the sequence number again
+// - zero padding up to a multiple of the memory bus width
+// all signals are sampled in the same cycle. the host compares the two
+// sequence numbers to detect a block that was being rewritten while read.
+
+// where each signal goes in the block, also used to generate the C++ struct
+// that decodes it
+class StatusBlockLayout(val name: String, val fields: Seq[(String, Int)], memDataBits: Int) {
+  for((n, w) <- fields)
+    if(n == "seq" || n == "seqEnd" || n == "pad")
+      throw new Exception("Reserved status block signal name " + n)
+  def wordsFor(width: Int): Int = (width + 63) / 64
+  // words holding the signals
+  val fieldWords: Int = fields.map(f => wordsFor(f._2)).sum
+  val padWords: Int = {
+    val wordsPerBeat = memDataBits / 64
+    val used = fieldWords + 2
+    (used + wordsPerBeat - 1) / wordsPerBeat * wordsPerBeat - used
+  }
+  val numWords: Int = fieldWords + 2 + padWords
+  val numBytes: Int = numWords * 8
+}
+
+// control and status of a StatusBlockWriter, meant to be register-mapped as
+// part of the accelerator I/O. a snapshot is written on a rising edge of
+// trigger, and every periodCycles cycles if that is nonzero, but only once
+// baseAddr is set. blocksWritten counts the snapshots that have been fully
+// written to memory.
+class StatusBlockCtrlIF() extends Bundle {
+  val baseAddr = UInt(INPUT, 64)
+  val trigger = Bool(INPUT)
+  val periodCycles = UInt(INPUT, 32)
+  val blocksWritten = UInt(OUTPUT, 32)
+}
+
+class StatusBlockWriter(val layout: StatusBlockLayout, mrp: MemReqParams,
+  chanID: Int, maxBeats: Int = 1) extends Module {
+  val io = new Bundle {
+    val ctrl = new StatusBlockCtrlIF()
+    // the signals, already split into 64-bit words (see StatusBlockWriter.connectFields)
+    val fields = Vec.fill(layout.fieldWords) { UInt(INPUT, 64) }
+    // interface towards memory port
+    val req = Decoupled(new GenericMemoryRequest(mrp))
+    val wdat = Decoupled(UInt(width = mrp.dataWidth))
+    val rsp = Decoupled(new GenericMemoryResponse(mrp)).flip
+  }
+  if(mrp.dataWidth % 64 != 0)
+    throw new Exception("StatusBlockWriter needs a memory bus width multiple of 64")
+  if(layout.fieldWords == 0)
+    throw new Exception("StatusBlockWriter " + layout.name + " has no signals")
+
+  val sIdle :: sWrite :: Nil = Enum(UInt(), 2)
+  val regState = Reg(init = UInt(sIdle))
+  val regSeq = Reg(init = UInt(0, 64))
+  val regBlocksWritten = Reg(init = UInt(0, 32))
+  val regBlock = Vec.fill(layout.numWords) { Reg(init = UInt(0, 64)) }
+  val regWordInd = Reg(init = UInt(0, log2Up(layout.numWords + 1)))
+
+  // snapshot requests. those arriving while a block is being written are
+  // held until it is done
+  val regTrigger = Reg(init = Bool(false), next = io.ctrl.trigger)
+  val regTimer = Reg(init = UInt(0, 32))
+  val regPending = Reg(init = Bool(false))
+  val periodic = (io.ctrl.periodCycles != UInt(0))
+  val timerExpired = periodic & (regTimer >= io.ctrl.periodCycles - UInt(1))
+  regTimer := Mux(!periodic | timerExpired, UInt(0), regTimer + UInt(1))
+  val triggered = (io.ctrl.trigger & !regTrigger) | timerExpired | regPending
+  val request = triggered & (io.ctrl.baseAddr != UInt(0))
+
+  val sw = Module(new StreamWriter(new StreamWriterParams(
+    streamWidth = 64, mem = mrp, chanID = chanID, maxBeats = maxBeats
+  ))).io
+
+  // start drops for at least one cycle between blocks, which resets the
+  // StreamWriter
+  sw.start := (regState === sWrite)
+  sw.baseAddr := io.ctrl.baseAddr
+  sw.byteCount := UInt(layout.numBytes)
+  sw.req <> io.req
+  sw.wdat <> io.wdat
+  io.rsp <> sw.rsp
+
+  sw.in.valid := (regState === sWrite) & (regWordInd < UInt(layout.numWords))
+  sw.in.bits := regBlock(regWordInd)
+  io.ctrl.blocksWritten := regBlocksWritten
+
+  switch(regState) {
+    is(sIdle) {
+      regPending := Bool(false)
+      when(request) {
+        val seq = regSeq + UInt(1)
+        regSeq := seq
+        regBlock(0) := seq
+        for(i <- 0 until layout.fieldWords) { regBlock(i + 1) := io.fields(i) }
+        regBlock(layout.fieldWords + 1) := seq
+        regWordInd := UInt(0)
+        regState := sWrite
+      }
+    }
+
+    is(sWrite) {
+      when(triggered) { regPending := Bool(true) }
+      when(sw.in.valid & sw.in.ready) { regWordInd := regWordInd + UInt(1) }
+      when(sw.finished) {
+        regBlocksWritten := regBlocksWritten + UInt(1)
+        regState := sIdle
+      }
+    }
+  }
+}
+
+object StatusBlockWriter {
+  // drives the field words of a StatusBlockWriter from the signals its
+  // layout was made for
+  def connectFields(sbw: StatusBlockWriter, fields: Seq[(String, Bits)]) {
+    var word = 0
+    for((name, bits) <- fields) {
+      val w = bits.getWidth()
+      for(i <- 0 until sbw.layout.wordsFor(w)) {
+        sbw.io.fields(word) := bits(scala.math.min(64*i + 63, w - 1), 64*i)
+        word += 1
+      }
+    }
+  }
+}
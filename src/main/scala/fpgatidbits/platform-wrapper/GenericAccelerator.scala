@@ -3,6 +3,7 @@ package fpgatidbits.PlatformWrapper
 import Chisel._
 import fpgatidbits.dma._
 import scala.collection.mutable.LinkedHashMap
+import scala.collection.mutable.ArrayBuffer
 
 // TODO should the parameters for GenericAccelerator be separated from the
 // parameters for PlatformWrapper?
@@ -54,6 +55,31 @@ abstract class GenericAccelerator(val p: PlatformWrapperParams) extends Module {
     io.memPort(i).memWrDat.bits := UInt(0)
     io.memPort(i).memWrRsp.ready := Bool(false)
   }
+
+  // status blocks written by this accelerator, the generated register
+  // driver gets a struct for decoding each of them
+  val statusBlocks = ArrayBuffer[StatusBlockLayout]()
+
+  // writes snapshots of the given signals to host memory through the write
+  // channel of memory port i, controlled by ctrl (see StatusBlockWriter).
+  // the name is used for the generated C++ struct, <name>Block
+  def makeStatusBlockWriter(name: String, ctrl: StatusBlockCtrlIF,
+    fields: Seq[(String, Bits)], i: Int, chanID: Int = 0): StatusBlockWriter = {
+    if(statusBlocks.exists(_.name == name))
+      throw new Exception("Duplicate status block " + name)
+    for((n, bits) <- fields)
+      if(bits.getWidth() <= 0)
+        throw new Exception("Status block signal " + n + " needs a known width")
+    val layout = new StatusBlockLayout(name, fields.map(f => (f._1, f._2.getWidth())), p.memDataBits)
+    val sbw = Module(new StatusBlockWriter(layout, p.toMemReqParams(), chanID))
+    sbw.io.ctrl <> ctrl
+    StatusBlockWriter.connectFields(sbw, fields)
+    sbw.io.req <> io.memPort(i).memWrReq
+    sbw.io.wdat <> io.memPort(i).memWrDat
+    io.memPort(i).memWrRsp <> sbw.io.rsp
+    statusBlocks += layout
+    return sbw
+  }
   // use the class name as the accel name
   // just set to something else in derived class if needed
   setName(this.getClass.getSimpleName)
@@ -25,7 +25,10 @@ trait PlatformWrapperParams {
   def memIDBits: Int
   def memMetaBits: Int
   def sameIDInOrder: Boolean
-  val csrDataBits: Int = 32 // TODO let platforms configure own CSR width
+  // width of the control/status registers, 32 or 64 bits. platforms with a
+  // native 64-bit CSR space override this, which halves the register
+  // accesses for addresses and other 64-bit values
+  def csrDataBits: Int = 32
 
   def toMemReqParams(): MemReqParams = {
     new MemReqParams(memAddrBits, memDataBits, memIDBits, memMetaBits, sameIDInOrder)
@@ -53,7 +56,9 @@ extends Module {
 
   // a list of files that will be needed for compiling drivers for platform
   val baseDriverFiles: Array[String] = Array[String](
-    "platform.h", "wrapperregdriver.h"
+    "platform.h", "wrapperregdriver.h", "mappedfile.hpp", "streamrunner.hpp",
+    "threadsaferegdriver.hpp", "channelscheduler.hpp", "perfseries.hpp",
+    "benchmark.hpp", "instrumentedregdriver.hpp", "shadowregdriver.hpp"
   )
   def platformDriverFiles: Array[String]  // additional files
 
@@ -76,13 +81,28 @@ extends Module {
   // each I/O is assigned to at least one register index, possibly more if wide
   // round each I/O width to nearest csrWidth multiple, sum, divide by csrWidth
   val wCSR = p.csrDataBits
+  if(wCSR != 32 && wCSR != 64)
+    throw new Exception("Unsupported CSR width " + wCSR + ", must be 32 or 64")
   def roundMultiple(n: Int, m: Int) = { (n + m-1) / m * m}
   val fxn = {x: (String, Bits) => (roundMultiple(x._2.getWidth(), wCSR))}
   val numRegs = ownIO.map(fxn).reduce({_+_}) / wCSR
 
+  // outputs wider than a register are read through the register file's
+  // snapshot-on-read, so that they don't tear. the registers are allocated
+  // below in this same order, signature first
+  val wideOutputRegs: Seq[Seq[Int]] = {
+    var r = 1
+    ownIO.filter(_._1 != "signature").toSeq.flatMap { case (name, bits) =>
+      val n = roundMultiple(bits.getWidth(), wCSR) / wCSR
+      val regs = (r until r + n).toSeq
+      r += n
+      if(bits.dir == OUTPUT && n > 1) Some(regs) else None
+    }
+  }
+
   // instantiate the register file
   val regAddrBits = log2Up(numRegs)
-  val regFile = Module(new RegFile(numRegs, regAddrBits, wCSR)).io
+  val regFile = Module(new RegFile(numRegs, regAddrBits, wCSR, wideOutputRegs)).io
 
   // hack: detect writes to register 0 to control accelerator reset
   val rfcmd = regFile.extIF.cmd
@@ -147,6 +167,14 @@ extends Module {
       }
     }
   }
+  val allocatedWideOutputs = ownIO.filter(x => x._2.dir == OUTPUT && regFileMap(x._1).size > 1)
+  if(allocatedWideOutputs.map(x => regFileMap(x._1).toSeq).toSeq != wideOutputRegs)
+    throw new Exception("Snapshot groups do not match the register allocation")
+
+  // completion interrupt: a 1-bit finished output doubles as a level-high
+  // interrupt line, which platforms that can route one expose as irq
+  val hasCompletionIrq = ownIO.get("finished").exists(b => b.dir == OUTPUT && b.getWidth() == 1)
+  val completionIrq: Bool = if(hasCompletionIrq) ownIO("finished").toBool else Bool(false)
 
   def makeRegReadFxn(regName: String): String = {
     var fxnStr: String = ""
@@ -155,18 +183,30 @@ extends Module {
       // single register read
       fxnStr += "  AccelReg get_" + regName + "()"
       fxnStr += " {return readReg(" + regs(0).toString + ");} "
-    } else if(regs.size == 2) {
-      // two-register read
-      // TODO this uses a hardcoded assumption about wCSR=32
-      if(wCSR != 32) throw new Exception("Violating assumption on wCSR=32")
-      fxnStr += "  AccelDblReg get_" + regName + "() "
-      fxnStr += "{ return (AccelDblReg)readReg("+regs(1).toString+") << 32 "
-      fxnStr += "| (AccelDblReg)readReg("+regs(0).toString+"); }"
-    } else { throw new Exception("Multi-reg reads not yet implemented") }
+    } else {
+      // multi-register read as a single batch. the lowest register goes
+      // first, which makes the register file snapshot the other words
+      val n = regs.size
+      fxnStr += "  " + regCppType(regName) + " get_" + regName + "() "
+      fxnStr += "{ unsigned int inds[" + n + "] = {" + regs.mkString(", ") + "}; "
+      fxnStr += "AccelReg vals[" + n + "]; readRegs(" + n + ", inds, vals); "
+      fxnStr += "return " + regReadExpr(regName, r => "vals[" + regs.indexOf(r) + "]") + "; }"
+    }
 
     return fxnStr
   }
 
+  // blocking wait until a single-register output holds the given value
+  def makeRegWaitFxn(regName: String): String = {
+    var fxnStr: String = ""
+    val regs = regFileMap(regName)
+    if(regs.size == 1) {
+      fxnStr += "  bool wait_" + regName + "(AccelReg value, uint64_t timeoutUs = 0)"
+      fxnStr += " {return m_platform->waitForCompletion(" + regs(0).toString + ", value, timeoutUs);} "
+    }
+    return fxnStr
+  }
+
   def makeRegWriteFxn(regName: String): String = {
     var fxnStr: String = ""
     val regs = regFileMap(regName)
@@ -174,18 +214,269 @@ extends Module {
       // single register write
       fxnStr += "  void set_" + regName + "(AccelReg value)"
       fxnStr += " {writeReg(" + regs(0).toString + ", value);} "
-    } else if(regs.size == 2) {
-      // two-register write
-      // TODO this uses a hardcoded assumption about wCSR=32
-      if(wCSR != 32) throw new Exception("Violating assumption on wCSR=32")
-      fxnStr += "  void set_" + regName + "(AccelDblReg value)"
-      fxnStr += " { writeReg("+regs(0).toString+", (AccelReg)(value >> 32)); "
-      fxnStr += "writeReg("+regs(1).toString+", (AccelReg)(value & 0xffffffff)); }"
-    } else { throw new Exception("Multi-reg writes not yet implemented") }
+    } else {
+      // multi-register write, issued as a single batch
+      val n = regs.size
+      val paramType = if(isScalarReg(regName)) regCppType(regName) else "const " + regCppType(regName) + " &"
+      val writes = regWriteExprs(regName, "value")
+      fxnStr += "  void set_" + regName + "(" + paramType + " value)"
+      fxnStr += " { unsigned int inds[" + n + "] = {" + writes.map(_._1).mkString(", ") + "}; "
+      fxnStr += "AccelReg vals[" + n + "] = {" + writes.map(_._2).mkString(", ") + "}; "
+      fxnStr += "writeRegs(" + n + ", inds, vals); }"
+    }
 
     return fxnStr
   }
 
+  // true if the signal fits into a 64-bit C++ integer
+  def isScalarReg(regName: String): Boolean = {
+    regFileMap(regName).size * wCSR <= 64
+  }
+
+  // C++ type used to hold the value of a register-mapped signal
+  def regCppType(regName: String): String = {
+    val n = regFileMap(regName).size
+    if(n == 1) "AccelReg"
+    else if(isScalarReg(regName)) "AccelDblReg"
+    else "AccelWideReg<" + n + ">"
+  }
+
+  // (register index, C++ value expression) pairs for writing the C++
+  // expression v into the registers of the given signal. inputs are the
+  // concatenation of their registers, so the first register holds the most
+  // significant word
+  def regWriteExprs(regName: String, v: String): Seq[(Int, String)] = {
+    val regs = regFileMap(regName)
+    if(regs.size == 1) {
+      Seq((regs(0), v))
+    } else if(isScalarReg(regName)) {
+      // two 32-bit registers
+      Seq((regs(0), s"(AccelReg)($v >> 32)"), (regs(1), s"(AccelReg)($v & 0xffffffff)"))
+    } else {
+      val n = regs.size
+      (0 until n).map(i => (regs(i), s"$v.words[${n-1-i}]"))
+    }
+  }
+
+  // C++ expression assembling the value of the given signal, where regVal
+  // gives the C++ expression for the value of each register index. outputs
+  // hold the least significant word in the first register
+  def regReadExpr(regName: String, regVal: Int => String): String = {
+    val regs = regFileMap(regName)
+    if(regs.size == 1) {
+      regVal(regs(0))
+    } else if(isScalarReg(regName)) {
+      // two 32-bit registers
+      s"(AccelDblReg)${regVal(regs(1))} << 32 | (AccelDblReg)${regVal(regs(0))}"
+    } else {
+      regCppType(regName) + "{{" + regs.map(regVal).mkString(", ") + "}}"
+    }
+  }
+
+  def makeRegStruct(structName: String, regNames: Seq[String]): String = {
+    val fields = regNames.map(n => "    " + regCppType(n) + " " + n + ";\n")
+    return "  struct " + structName + " {\n" + fields.mkString + "  };\n"
+  }
+
+  // configure() writes all given input registers with a single writeRegs
+  def makeConfigureFxn(regNames: Seq[String]): String = {
+    val writes = regNames.flatMap(n => regWriteExprs(n, "cfg." + n))
+    val n = writes.size
+    var fxnStr: String = makeRegStruct("Config", regNames)
+    fxnStr += "  void configure(const Config & cfg) {\n"
+    fxnStr += "    unsigned int inds[" + n + "] = {" + writes.map(_._1).mkString(", ") + "};\n"
+    fxnStr += "    AccelReg vals[" + n + "] = {" + writes.map(_._2).mkString(", ") + "};\n"
+    fxnStr += "    writeRegs(" + n + ", inds, vals);\n"
+    fxnStr += "  }\n"
+    return fxnStr
+  }
+
+  // snapshotStatus() reads all given output registers with a single readRegs
+  def makeSnapshotFxn(regNames: Seq[String]): String = {
+    val regs = regNames.flatMap(n => regFileMap(n).toSeq)
+    val pos = regs.zipWithIndex.toMap
+    val n = regs.size
+    var fxnStr: String = makeRegStruct("Status", regNames)
+    fxnStr += "  Status snapshotStatus() {\n"
+    fxnStr += "    unsigned int inds[" + n + "] = {" + regs.mkString(", ") + "};\n"
+    fxnStr += "    AccelReg vals[" + n + "];\n"
+    fxnStr += "    readRegs(" + n + ", inds, vals);\n"
+    fxnStr += "    Status st;\n"
+    for(name <- regNames) {
+      fxnStr += "    st." + name + " = " + regReadExpr(name, r => "vals[" + pos(r) + "]") + ";\n"
+    }
+    fxnStr += "    return st;\n"
+    fxnStr += "  }\n"
+    return fxnStr
+  }
+
+  // snapshotPerf() reads all performance counters (outputs named perf_*)
+  // with a single readRegs, and assembles them into 64-bit values if they
+  // span two registers
+  def makePerfFxns(regNames: Seq[String]): String = {
+    val regs = regNames.flatMap(n => regFileMap(n).toSeq)
+    val pos = regs.zipWithIndex.toMap
+    val n = regs.size
+    var fxnStr: String = ""
+    fxnStr += "  static vector<string> perfCounterNames() {\n"
+    fxnStr += "    return {" + regNames.map("\"" + _ + "\"").mkString(", ") + "};\n"
+    fxnStr += "  }\n"
+    fxnStr += "  PerfSnapshot snapshotPerf() {\n"
+    fxnStr += "    PerfSnapshot s;\n"
+    fxnStr += "    s.timestampUs = PerfSeries::timestampUs();\n"
+    if(n > 0) {
+      fxnStr += "    unsigned int inds[" + n + "] = {" + regs.mkString(", ") + "};\n"
+      fxnStr += "    AccelReg vals[" + n + "];\n"
+      fxnStr += "    readRegs(" + n + ", inds, vals);\n"
+      fxnStr += "    s.values.resize(" + regNames.size + ");\n"
+      for((name, i) <- regNames.zipWithIndex) {
+        fxnStr += "    s.values[" + i + "] = " + regReadExpr(name, r => "vals[" + pos(r) + "]") + ";\n"
+      }
+    }
+    fxnStr += "    return s;\n"
+    fxnStr += "  }\n"
+    fxnStr += "  PerfSeries makePerfSeries() {return PerfSeries(perfCounterNames());}\n"
+    fxnStr += "  void samplePerf(PerfSeries & series) {series.add(snapshotPerf());}\n"
+    return fxnStr
+  }
+
+  // register map of all register-mapped signals: an enum of IDs in name
+  // order, a constexpr table with their register indices, a name lookup
+  // by binary search over that table and accessors by ID. nothing is
+  // allocated, so monitoring loops can resolve names once and then poll
+  def makeRegMapFxns(): String = {
+    val names = ownIO.keys.toSeq.sorted
+    for(n <- names) {
+      val regs = regFileMap(n)
+      if(regs.toSeq != (regs(0) until regs(0) + regs.size))
+        throw new Exception("Non-consecutive registers for " + n)
+    }
+    val maxBatch = 64
+    // registers per signal that still fit an AccelDblReg
+    val maxScalarRegs = 64 / wCSR
+    val maxSignalRegs = names.map(regFileMap(_).size).max
+    var fxnStr: String = ""
+    fxnStr += "  // register map, one ID per signal in name order\n"
+    fxnStr += "  enum RegID {\n"
+    fxnStr += names.map("    REG_" + _ + ",\n").mkString
+    fxnStr += "    NUM_REG_IDS\n"
+    fxnStr += "  };\n"
+    fxnStr += "  struct RegInfo {\n"
+    fxnStr += "    const char * name;\n"
+    fxnStr += "    unsigned int firstReg;    // wide signals use consecutive registers\n"
+    fxnStr += "    unsigned int numRegs;\n"
+    fxnStr += "    bool isOutput;\n"
+    fxnStr += "  };\n"
+    fxnStr += "  static const RegInfo & regInfo(RegID id) {\n"
+    fxnStr += "    static constexpr RegInfo info[NUM_REG_IDS] = {\n"
+    fxnStr += names.map(n => "      {\"" + n + "\", " + regFileMap(n)(0) + ", " +
+      regFileMap(n).size + ", " + (ownIO(n).dir == OUTPUT) + "}").mkString(",\n") + "\n"
+    fxnStr += "    };\n"
+    fxnStr += "    return info[id];\n"
+    fxnStr += "  }\n"
+    fxnStr += "  // width of each register on this platform\n"
+    fxnStr += "  static const unsigned int csrDataBits = " + wCSR + ";\n"
+    fxnStr += "  // value of a signal of up to 64 bits from its register words. outputs\n"
+    fxnStr += "  // hold the least significant word in the first register, inputs the\n"
+    fxnStr += "  // most significant one\n"
+    fxnStr += "  static AccelDblReg combineWords(const RegInfo & r, const AccelReg * vals) {\n"
+    if(maxScalarRegs == 1) {
+      fxnStr += "    return vals[0];\n"
+    } else {
+      fxnStr += "    if(r.numRegs == 1) return vals[0];\n"
+      fxnStr += "    AccelReg lo = r.isOutput ? vals[0] : vals[1];\n"
+      fxnStr += "    AccelReg hi = r.isOutput ? vals[1] : vals[0];\n"
+      fxnStr += "    return (AccelDblReg) hi << 32 | (AccelDblReg) lo;\n"
+    }
+    fxnStr += "  }\n"
+    fxnStr += "  // binary search over the sorted names\n"
+    fxnStr += "  static RegID regIDFromName(const char * name) {\n"
+    fxnStr += "    unsigned int lo = 0, hi = NUM_REG_IDS;\n"
+    fxnStr += "    while(lo < hi) {\n"
+    fxnStr += "      unsigned int mid = (lo + hi) / 2;\n"
+    fxnStr += "      int c = strcmp(name, regInfo((RegID) mid).name);\n"
+    fxnStr += "      if(c == 0) return (RegID) mid;\n"
+    fxnStr += "      if(c < 0) hi = mid; else lo = mid + 1;\n"
+    fxnStr += "    }\n"
+    fxnStr += "    throw \"Unknown register\";\n"
+    fxnStr += "  }\n"
+    fxnStr += "  AccelDblReg readStatusReg(RegID id) {\n"
+    fxnStr += "    const RegInfo & r = regInfo(id);\n"
+    fxnStr += "    if(r.numRegs == 1) return readReg(r.firstReg);\n"
+    fxnStr += "    if(r.numRegs > " + maxScalarRegs + ") throw \">64 bit status regs are not yet supported from readStatusReg\";\n"
+    fxnStr += "    unsigned int inds[2] = {r.firstReg, r.firstReg + 1};\n"
+    fxnStr += "    AccelReg vals[2];\n"
+    fxnStr += "    readRegs(2, inds, vals);\n"
+    fxnStr += "    return combineWords(r, vals);\n"
+    fxnStr += "  }\n"
+    fxnStr += "  // all words of a signal of any width, least significant first\n"
+    fxnStr += "  void readStatusRegWords(RegID id, AccelReg * words) {\n"
+    fxnStr += "    const RegInfo & r = regInfo(id);\n"
+    fxnStr += "    unsigned int inds[" + maxSignalRegs + "];\n"
+    fxnStr += "    for(unsigned int j = 0; j < r.numRegs; j++) inds[j] = r.firstReg + j;\n"
+    fxnStr += "    readRegs(r.numRegs, inds, words);\n"
+    fxnStr += "    if(!r.isOutput)\n"
+    fxnStr += "      for(unsigned int j = 0; j < r.numRegs / 2; j++) {\n"
+    fxnStr += "        AccelReg w = words[j]; words[j] = words[r.numRegs-1-j]; words[r.numRegs-1-j] = w;\n"
+    fxnStr += "      }\n"
+    fxnStr += "  }\n"
+    fxnStr += "  AccelDblReg readStatusReg(const string & regName) {\n"
+    fxnStr += "    return readStatusReg(regIDFromName(regName.c_str()));\n"
+    fxnStr += "  }\n"
+    fxnStr += "  // reads the given signals with as few readRegs batches as possible\n"
+    fxnStr += "  void readStatusRegs(unsigned int n, const RegID * ids, AccelDblReg * values) {\n"
+    fxnStr += "    unsigned int inds[" + maxBatch + "];\n"
+    fxnStr += "    AccelReg vals[" + maxBatch + "];\n"
+    fxnStr += "    unsigned int i = 0;\n"
+    fxnStr += "    while(i < n) {\n"
+    fxnStr += "      unsigned int first = i, k = 0;\n"
+    fxnStr += "      for(; i < n && k + " + maxScalarRegs + " <= " + maxBatch + "; i++) {\n"
+    fxnStr += "        const RegInfo & r = regInfo(ids[i]);\n"
+    fxnStr += "        if(r.numRegs > " + maxScalarRegs + ") throw \">64 bit status regs are not yet supported from readStatusRegs\";\n"
+    fxnStr += "        for(unsigned int j = 0; j < r.numRegs; j++) inds[k++] = r.firstReg + j;\n"
+    fxnStr += "      }\n"
+    fxnStr += "      readRegs(k, inds, vals);\n"
+    fxnStr += "      for(k = 0; first < i; first++) {\n"
+    fxnStr += "        values[first] = combineWords(regInfo(ids[first]), &vals[k]);\n"
+    fxnStr += "        k += regInfo(ids[first]).numRegs;\n"
+    fxnStr += "      }\n"
+    fxnStr += "    }\n"
+    fxnStr += "  }\n"
+    return fxnStr
+  }
+
+  // struct with the layout of a status block written by the accelerator
+  // (see StatusBlockWriter), and a function to fetch one from an
+  // accelerator buffer with a single copy
+  def makeStatusBlockFxns(b: StatusBlockLayout): String = {
+    val structName = b.name + "Block"
+    var fxnStr: String = ""
+    fxnStr += "  // layout of the " + b.name + " status block written by the accelerator\n"
+    fxnStr += "  struct " + structName + " {\n"
+    fxnStr += "    uint64_t seq;\n"
+    for((name, w) <- b.fields) {
+      val n = b.wordsFor(w)
+      if(n == 1) fxnStr += "    uint64_t " + name + ";\n"
+      else fxnStr += "    uint64_t " + name + "[" + n + "];   // least significant first\n"
+    }
+    fxnStr += "    uint64_t seqEnd;\n"
+    if(b.padWords > 0) fxnStr += "    uint64_t pad[" + b.padWords + "];\n"
+    fxnStr += "  };\n"
+    fxnStr += "  static_assert(sizeof(" + structName + ") == " + b.numBytes + ", \"Unexpected " + structName + " layout\");\n"
+    fxnStr += "  // returns false if the block was being rewritten while it was read\n"
+    fxnStr += "  bool read" + structName + "(void * accelBuffer, " + structName + " & block) {\n"
+    fxnStr += "    void * hostPtr = m_platform->getHostPointer(accelBuffer);\n"
+    fxnStr += "    if(hostPtr) {\n"
+    fxnStr += "      m_platform->syncBufferForHost(accelBuffer, sizeof(block));\n"
+    fxnStr += "      memcpy(&block, hostPtr, sizeof(block));\n"
+    fxnStr += "    } else {\n"
+    fxnStr += "      m_platform->copyBufferAccelToHost(accelBuffer, &block, sizeof(block));\n"
+    fxnStr += "    }\n"
+    fxnStr += "    return block.seq == block.seqEnd;\n"
+    fxnStr += "  }\n"
+    return fxnStr
+  }
+
   def generateRegDriver(targetDir: String) = {
     var driverStr: String = ""
     val driverName: String = accel.name
@@ -195,20 +486,40 @@ extends Module {
         readWriteFxns += makeRegWriteFxn(name) + "\n"
       } else if(bits.dir == OUTPUT) {
         readWriteFxns += makeRegReadFxn(name) + "\n"
+        if(regFileMap(name).size == 1)
+          readWriteFxns += makeRegWaitFxn(name) + "\n"
       }
     }
 
-    def statRegToCPPMapEntry(regName: String): String = {
-      val inds = regFileMap(regName).map(_.toString).reduce(_ + ", " + _)
-      return s""" {"$regName", {$inds}} """
-    }
     val statRegs = ownIO.filter(x => x._2.dir == OUTPUT).map(_._1)
-    val statRegMap = statRegs.map(statRegToCPPMapEntry).reduce(_ + ", " + _)
+
+    // batched helpers for programming all inputs and reading all outputs.
+    // start is written last, so that configure() with start = 1 launches
+    // the accelerator only after everything else has been set up
+    val ctrlRegs = ownIO.filter(x => x._2.dir == INPUT).map(_._1).toSeq
+    val cfgRegs = ctrlRegs.filter(_ != "start") ++ ctrlRegs.filter(_ == "start")
+    var batchFxns: String = makeSnapshotFxn(statRegs.toSeq)
+    if(cfgRegs.size > 0) batchFxns = makeConfigureFxn(cfgRegs) + "\n" + batchFxns
+    val perfRegs = statRegs.filter(x => x.startsWith("perf_") && isScalarReg(x)).toSeq.sorted
+    batchFxns += "\n" + makePerfFxns(perfRegs)
+    val regMapFxns = makeRegMapFxns()
+    for(b <- accel.statusBlocks)
+      batchFxns += "\n" + makeStatusBlockFxns(b)
+    // single-bit inputs are control strobes (start, doInit...), writes to
+    // them must not be cached or coalesced by the driver layers
+    val volatileRegs = ownIO.filter(x => x._2.dir == INPUT && x._2.getWidth() == 1)
+      .map(x => regFileMap(x._1)(0)).toSeq.sorted
+    val markVolatile = volatileRegs.map(r => s"    m_platform->setVolatileReg($r);\n").mkString
+    // lets the platform sleep on the completion interrupt in wait_finished
+    val markIrq = if(!hasCompletionIrq) "" else
+      "    m_platform->setInterruptReg(" + regFileMap("finished")(0) + ");\n"
 
     driverStr += s"""
 #ifndef ${driverName}_H
 #define ${driverName}_H
 #include "wrapperregdriver.h"
+#include "perfseries.hpp"
+#include <string.h>
 #include <map>
 #include <string>
 #include <vector>
@@ -225,23 +536,28 @@ public:
   }
 
   $readWriteFxns
-
+$batchFxns
+$regMapFxns
+  // output name -> register indices, built from the register map
   map<string, vector<unsigned int>> getStatusRegs() {
-    map<string, vector<unsigned int>> ret = {$statRegMap};
+    map<string, vector<unsigned int>> ret;
+    for(unsigned int i = 0; i < NUM_REG_IDS; i++) {
+      const RegInfo & r = regInfo((RegID) i);
+      if(!r.isOutput) continue;
+      for(unsigned int j = 0; j < r.numRegs; j++) ret[r.name].push_back(r.firstReg + j);
+    }
     return ret;
   }
 
-  AccelReg readStatusReg(string regName) {
-    map<string, vector<unsigned int>> statRegMap = getStatusRegs();
-    if(statRegMap[regName].size() != 1) throw ">32 bit status regs are not yet supported from readStatusReg";
-    return readReg(statRegMap[regName][0]);
-  }
-
 protected:
   WrapperRegDriver * m_platform;
   AccelReg readReg(unsigned int i) {return m_platform->readReg(i);}
   void writeReg(unsigned int i, AccelReg v) {m_platform->writeReg(i,v);}
-  void attach() {m_platform->attach("$driverName");}
+  void readRegs(unsigned int n, const unsigned int * i, AccelReg * v) {m_platform->readRegs(n,i,v);}
+  void writeRegs(unsigned int n, const unsigned int * i, const AccelReg * v) {m_platform->writeRegs(n,i,v);}
+  void attach() {
+    m_platform->attach("$driverName");
+$markVolatile$markIrq  }
   void detach() {m_platform->detach();}
 };
 #endif
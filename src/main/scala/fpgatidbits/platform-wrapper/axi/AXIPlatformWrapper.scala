@@ -19,11 +19,15 @@ abstract class AXIPlatformWrapper(p: PlatformWrapperParams,
     val mem = Vec.fill (p.numMemPorts) {
       new AXIMasterIF(p.memAddrBits, p.memDataBits, p.memIDBits)
     }
+    // level-high completion interrupt, tied low if the accelerator has none
+    val irq = Bool(OUTPUT)
   }
 
   // rename signals to support Vivado interface inference
   io.csr.renameSignals("csr")
   for(i <- 0 until p.numMemPorts) {io.mem(i).renameSignals(s"mem$i")}
+  io.irq.setName("irq")
+  io.irq := completionIrq
 
   // memory port adapters and connections
   // TODO use accel numMemPorts and plug unused
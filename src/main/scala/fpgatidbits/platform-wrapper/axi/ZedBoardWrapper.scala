@@ -27,6 +27,7 @@ class ZedBoardWrapper(instFxn: PlatformWrapperParams => GenericAccelerator)
 class ZedBoardLinuxWrapper(instFxn: PlatformWrapperParams => GenericAccelerator)
 extends AXIPlatformWrapper(ZedBoardParams, instFxn) {
   val platformDriverFiles = baseDriverFiles ++ Array[String](
-    "platform-zedboard-linux.cpp", "linuxphysregdriver.hpp", "axiregdriver.hpp"
+    "platform-zedboard-linux.cpp", "linuxphysregdriver.hpp", "axiregdriver.hpp",
+    "bufferallocator.hpp", "copyengine.hpp", "uioregdriver.hpp"
   )
 }
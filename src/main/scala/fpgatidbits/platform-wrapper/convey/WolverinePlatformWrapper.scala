@@ -20,6 +20,8 @@ object WX690TParams extends PlatformWrapperParams {
   val sameIDInOrder = false
   val typicalMemLatencyCycles = 128
   val burstBeats = 8
+  // the CSR and AEG interfaces are natively 64 bits wide
+  override val csrDataBits = 64
 }
 
 // TODO plug unused platform ports if accel has less mem ports
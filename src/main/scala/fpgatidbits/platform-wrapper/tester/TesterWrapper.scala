@@ -4,8 +4,9 @@ import Chisel._
 import fpgatidbits.axi._
 import fpgatidbits.dma._
 import fpgatidbits.regfile._
-import java.nio.file.{Files, Paths}
+import java.nio.file.{Files, Paths, StandardOpenOption}
 import java.nio.ByteBuffer
+import java.nio.channels.FileChannel
 import java.io.FileOutputStream
 
 // testing infrastructure for GenericAccelerator
@@ -26,12 +27,55 @@ object TesterWrapperParams extends PlatformWrapperParams {
   val burstBeats = 8
 }
 
-class TesterWrapper(instFxn: PlatformWrapperParams => GenericAccelerator)
+// hooks for the memory timing model in the C++ emulator drivers
+// (emumemmodel.hpp), one per accelerator memory port. requests are reported
+// when the accelerator issues them, and the driver can stall the data beats
+// of each port to model DRAM latency and bandwidth. with the stall inputs
+// left at zero, the memory has a fixed latency and unlimited bandwidth.
+class TesterMemTimingIF(p: PlatformWrapperParams) extends Bundle {
+  val rdReqFire = Bool(OUTPUT)
+  val rdReqAddr = UInt(OUTPUT, p.memAddrBits)
+  val rdReqBytes = UInt(OUTPUT, 8)
+  val rdBeatFire = Bool(OUTPUT)
+  val rdStall = Bool(INPUT)
+  val wrReqFire = Bool(OUTPUT)
+  val wrReqAddr = UInt(OUTPUT, p.memAddrBits)
+  val wrReqBytes = UInt(OUTPUT, 8)
+  val wrBeatFire = Bool(OUTPUT)
+  val wrStall = Bool(INPUT)
+
+  override def clone = {
+    new TesterMemTimingIF(p).asInstanceOf[this.type]
+  }
+}
+
+// data path of the accelerator memory ports, for when the main memory lives
+// in the C++ emulator driver (sparsemem.hpp) instead of in the model. the read
+// data for rdAddr is expected in the same cycle.
+class TesterMemDataIF(p: PlatformWrapperParams) extends Bundle {
+  val rdAddr = UInt(OUTPUT, p.memAddrBits)
+  val rdData = UInt(INPUT, p.memDataBits)
+  val wrEn = Bool(OUTPUT)
+  val wrAddr = UInt(OUTPUT, p.memAddrBits)
+  val wrData = UInt(OUTPUT, p.memDataBits)
+
+  override def clone = {
+    new TesterMemDataIF(p).asInstanceOf[this.type]
+  }
+}
+
+// extMem moves the main memory out of the model and into the emulator
+// driver, which keeps it in a sparse page table covering all of memAddrBits.
+// the C++ emulator drivers need this. without extMem, the model has a flat
+// 512 MB memory array, as GenericAccelTester expects.
+class TesterWrapper(instFxn: PlatformWrapperParams => GenericAccelerator,
+  val extMem: Boolean = false)
 extends PlatformWrapper(TesterWrapperParams, instFxn) {
   setName("TesterWrapper")
 
   val platformDriverFiles = baseDriverFiles ++ Array[String](
-    "platform-tester.cpp", "testerdriver.hpp"
+    "platform-tester.cpp", "testerdriver.hpp", "bufferallocator.hpp",
+    "sweeprunner.hpp", "checkpoint.hpp", "emumemmodel.hpp", "sparsemem.hpp"
   )
 
   val memWords = 64 * 1024 * 1024
@@ -46,21 +90,73 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
     val memWriteEn = Bool(INPUT)
     val memWriteData = UInt(INPUT, p.memDataBits)
     val memReadData = UInt(OUTPUT, p.memDataBits)
+    // memory timing model hooks (at least one, Chisel has no empty Vecs)
+    val memTiming = Vec.fill(math.max(accel.numMemPorts, 1)) {new TesterMemTimingIF(p)}
+    val memData = Vec.fill(math.max(accel.numMemPorts, 1)) {new TesterMemDataIF(p)}
+    // completion interrupt, the driver turns its rising edges into eventfd events
+    val irq = Bool(OUTPUT)
   }
   val accio = accel.io
 
+  for(i <- 0 until io.memTiming.size) {
+    io.memTiming(i).rdReqFire := Bool(false)
+    io.memTiming(i).rdReqAddr := UInt(0)
+    io.memTiming(i).rdReqBytes := UInt(0)
+    io.memTiming(i).rdBeatFire := Bool(false)
+    io.memTiming(i).wrReqFire := Bool(false)
+    io.memTiming(i).wrReqAddr := UInt(0)
+    io.memTiming(i).wrReqBytes := UInt(0)
+    io.memTiming(i).wrBeatFire := Bool(false)
+    io.memData(i).rdAddr := UInt(0)
+    io.memData(i).wrEn := Bool(false)
+    io.memData(i).wrAddr := UInt(0)
+    io.memData(i).wrData := UInt(0)
+  }
+
   // expose regfile interface for testbench
   io.regFileIF <> regFile.extIF
+  io.irq := completionIrq
 
   // instantiate the "main memory"
-  val mem = Mem(UInt(width=p.memDataBits), memWords)
+  val mem = if(extMem) null else Mem(UInt(width=p.memDataBits), memWords)
 
   // testbench memory access
   def addrToWord(x: UInt) = {x >> UInt(log2Up(p.memDataBits/8))}
   val memWord = addrToWord(io.memAddr)
-  io.memReadData := mem(memWord)
+  if(extMem) {
+    // the driver accesses its memory directly
+    io.memReadData := UInt(0)
+  } else {
+    io.memReadData := mem(memWord)
+    when (io.memWriteEn) {mem(memWord) := io.memWriteData}
+  }
 
-  when (io.memWriteEn) {mem(memWord) := io.memWriteData}
+  // in addition to the register driver, list the memory ports and address
+  // width for the memory hooks in the emulator drivers, and a fingerprint of
+  // this build that the emulator checkpoints are checked against. it covers
+  // the accelerator I/O and register map and the generation time, so a
+  // regenerated model never accepts an older checkpoint.
+  override def generateRegDriver(targetDir: String) = {
+    super.generateRegDriver(targetDir)
+    val ports = (0 until accel.numMemPorts).map(i => s"X($i)").mkString(" ")
+    val ioDesc = ownIO.map({case (n, b) =>
+      n + ":" + b.getWidth() + ":" + b.dir + ":" + regFileMap(n).mkString(",")}).mkString(";")
+    val fingerprint = accel.hexcrc32(fullName + ";" + ioDesc + ";" +
+      accel.numMemPorts + ";" + p.memAddrBits + ";" + System.currentTimeMillis)
+    val portStr = s"""// generated by TesterWrapper, lists the accelerator memory ports
+#ifndef TESTERMEMPORTS_H
+#define TESTERMEMPORTS_H
+#define TESTER_NUM_MEM_PORTS ${accel.numMemPorts}
+#define TESTER_MEM_ADDR_BITS ${p.memAddrBits}
+#define TESTER_MEM_PORTS(X) $ports
+#define TESTER_MODEL_FINGERPRINT 0x${fingerprint}ULL
+#endif
+"""
+    import java.io._
+    val writer = new PrintWriter(new File(targetDir+"/TesterMemPorts.h"))
+    writer.write(portStr)
+    writer.close()
+  }
 
   def addLatency[T <: Data](n: Int, prod: DecoupledIO[T]): DecoupledIO[T] = {
     if(n == 1) {
@@ -79,6 +175,15 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
     val regReadRequest = Reg(init = GenericMemoryRequest(mrp))
 
     val accmp = accio.memPort(i)
+    val timing = io.memTiming(i)
+    val data = io.memData(i)
+    timing.rdReqFire := accmp.memRdReq.valid & accmp.memRdReq.ready
+    timing.rdReqAddr := accmp.memRdReq.bits.addr
+    timing.rdReqBytes := accmp.memRdReq.bits.numBytes
+    timing.wrReqFire := accmp.memWrReq.valid & accmp.memWrReq.ready
+    timing.wrReqAddr := accmp.memWrReq.bits.addr
+    timing.wrReqBytes := accmp.memWrReq.bits.numBytes
+
     val accRdReq = addLatency(15, accmp.memRdReq)
     val accRdRsp = accmp.memRdRsp
 
@@ -88,7 +193,12 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
     accRdRsp.bits.metaData := UInt(0)
     accRdRsp.bits.isWrite := Bool(false)
     accRdRsp.bits.isLast := Bool(false)
-    accRdRsp.bits.readData := mem(addrToWord(regReadRequest.addr))
+    data.rdAddr := regReadRequest.addr
+    if(extMem) {
+      accRdRsp.bits.readData := data.rdData
+    } else {
+      accRdRsp.bits.readData := mem(addrToWord(regReadRequest.addr))
+    }
 
     switch(regStateRead) {
       is(sWaitRd) {
@@ -109,9 +219,10 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
           } .otherwise {regStateRead := sWaitRd}
         }
         .otherwise {
-          accRdRsp.valid := Bool(true)
+          accRdRsp.valid := !timing.rdStall
           accRdRsp.bits.isLast := (regReadRequest.numBytes === memUnitBytes)
-          when (accRdRsp.ready) {
+          when (accRdRsp.ready && !timing.rdStall) {
+            timing.rdBeatFire := Bool(true)
             regReadRequest.numBytes := regReadRequest.numBytes - memUnitBytes
             regReadRequest.addr := regReadRequest.addr + UInt(memUnitBytes)
 
@@ -149,6 +260,8 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
     wrRspQ.enq.valid := Bool(false)
     wrRspQ.enq.bits.driveDefaults()
     wrRspQ.enq.bits.channelID := regWriteRequest.channelID
+    data.wrAddr := regWriteRequest.addr
+    data.wrData := wrDatQ.deq.bits
 
     switch(regStateWrite) {
       is(sWaitWr) {
@@ -162,12 +275,16 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
       is(sWrite) {
         when(regWriteRequest.numBytes === UInt(0)) {regStateWrite := sWaitWr}
         .otherwise {
-          when(wrRspQ.enq.ready && wrDatQ.deq.valid) {
+          when(wrRspQ.enq.ready && wrDatQ.deq.valid && !timing.wrStall) {
+            timing.wrBeatFire := Bool(true)
             when(regWriteRequest.numBytes === memUnitBytes) {
               wrRspQ.enq.valid := Bool(true)
             }
             wrDatQ.deq.ready := Bool(true)
-            mem(addrToWord(regWriteRequest.addr)) := wrDatQ.deq.bits
+            data.wrEn := Bool(true)
+            if(!extMem) {
+              mem(addrToWord(regWriteRequest.addr)) := wrDatQ.deq.bits
+            }
             regWriteRequest.numBytes := regWriteRequest.numBytes - memUnitBytes
             regWriteRequest.addr := regWriteRequest.addr + UInt(memUnitBytes)
           }
@@ -178,6 +295,10 @@ extends PlatformWrapper(TesterWrapperParams, instFxn) {
 }
 
 class GenericAccelTester(c: TesterWrapper) extends Tester(c) {
+  if(c.extMem) {
+    println("GenericAccelTester needs a TesterWrapper with extMem = false")
+    System.exit(-1)
+  }
   // TODO add functions for initializing memory
   val memUnitBytes = c.memUnitBytes.litValue()
   val regFile = c.io.regFileIF
@@ -249,10 +370,27 @@ class GenericAccelTester(c: TesterWrapper) extends Tester(c) {
   }
 
   // read file and write into memory, starting at <baseAddr>
+  // the file is memory-mapped and streamed in one word at a time, so large
+  // files don't have to fit on the JVM heap
   def fileToMem(fileName: String, baseAddr: BigInt) = {
-    var buf = Files.readAllBytes(Paths.get(fileName))
     println("Loading "+fileName+" to baseAddr "+baseAddr.toString)
-    arrayToMem(buf, baseAddr)
+    val ch = FileChannel.open(Paths.get(fileName), StandardOpenOption.READ)
+    val unit = c.p.memDataBits/8
+    val word = new Array[Byte](unit)
+    var offset: Long = 0
+    // map in windows, a single mapping is limited to 2 GB
+    while(offset < ch.size()) {
+      val len = math.min(ch.size() - offset, 1L << 30)
+      val mb = ch.map(FileChannel.MapMode.READ_ONLY, offset, len)
+      while(mb.hasRemaining()) {
+        val n = math.min(unit, mb.remaining())
+        java.util.Arrays.fill(word, 0.toByte)
+        mb.get(word, 0, n)
+        memWordBackdoor(baseAddr + offset + mb.position() - n, word)
+      }
+      offset += len
+    }
+    ch.close()
   }
 
   def valueOf(buf: Array[Byte]): String = buf.map("%02X" format _).mkString
@@ -267,15 +405,22 @@ class GenericAccelTester(c: TesterWrapper) extends Tester(c) {
     }
     var i: Int = 0
     for(b <- buf.grouped(c.p.memDataBits/8)) {
-      val w : BigInt = new BigInt(new java.math.BigInteger(b.reverse))
-
-      //println("Read: " + valueOf(w.toByteArray))
-      //println("Read: " +i.toString+ "=" + valueOf(b))
-      writeMem(baseAddr+i*memUnitBytes, w)
+      memWordBackdoor(baseAddr+i*memUnitBytes, b)
       i += 1
     }
   }
 
+  // write one little-endian memory word directly into the memory array,
+  // without going through the testbench port (and clocking the design)
+  def memWordBackdoor(addr: BigInt, bytes: Array[Byte]) = {
+    if(addr % memUnitBytes != 0) {
+      println("fileToMem: base addr must be multiple of mem unit width")
+      System.exit(-1)
+    }
+    val w: BigInt = new BigInt(new java.math.BigInteger(1, bytes.reverse))
+    pokeAt(c.mem, w, (addr / memUnitBytes).toInt)
+  }
+
   def memToFile(fileName: String, baseAddr: BigInt, wordCount: Int) = {
     val fout = new FileOutputStream(fileName)
     for(i <- 0 until wordCount) {
@@ -300,8 +445,10 @@ class GenericAccelTester(c: TesterWrapper) extends Tester(c) {
 }
 
 class VerilatedTesterWrapper(instFxn: PlatformWrapperParams => GenericAccelerator)
-extends TesterWrapper(instFxn) {
+extends TesterWrapper(instFxn, extMem = true) {
   override val platformDriverFiles = baseDriverFiles ++ Array[String](
-    "platform-verilatedtester.cpp", "verilatedtesterdriver.hpp"
+    "platform-verilatedtester.cpp", "verilatedtesterdriver.hpp",
+    "bufferallocator.hpp", "sweeprunner.hpp", "checkpoint.hpp",
+    "emumemmodel.hpp", "sparsemem.hpp"
   )
 }
@@ -16,6 +16,7 @@ class TestCopy(p: PlatformWrapperParams) extends GenericAccelerator(p) {
     val dstAddr = UInt(INPUT, width = 64)
     val byteCount = UInt(INPUT, width = 32)
     val finBytes = UInt(OUTPUT, width = 32)
+    val cycleCount = UInt(OUTPUT, width = 32)
   }
   io.signature := makeDefaultSignature()
 
@@ -66,4 +67,9 @@ class TestCopy(p: PlatformWrapperParams) extends GenericAccelerator(p) {
 
   io.finished := io.start & (regRequestedBytes === io.byteCount) & (regNumPendingReqs === UInt(0))
   io.finBytes := regRequestedBytes
+
+  val regCycleCount = Reg(init = UInt(0, 32))
+  io.cycleCount := regCycleCount
+  when(!io.start) {regCycleCount := UInt(0)}
+  .elsewhen(io.start & !io.finished) {regCycleCount := regCycleCount + UInt(1)}
 }
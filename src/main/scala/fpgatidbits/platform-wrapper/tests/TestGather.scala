@@ -23,6 +23,8 @@ class TestGather(p: PlatformWrapperParams) extends GenericAccelerator(p) {
       val monRdRsp = new StreamMonitorOutIF()
       val resultsOoO = UInt(OUTPUT, 32)
     }
+    // the perf counters can also be collected as a status block
+    val statusBlock = new StatusBlockCtrlIF()
   }
   io.signature := makeDefaultSignature()
   val mrp = p.toMemReqParams()
@@ -141,4 +143,7 @@ class TestGather(p: PlatformWrapperParams) extends GenericAccelerator(p) {
   io.perf.monInds := StreamMonitor(inds.out, doMon, "inds")
   io.perf.monRdReq := StreamMonitor(io.memPort(1).memRdReq, doMon, "rdreq")
   io.perf.monRdRsp := StreamMonitor(io.memPort(1).memRdRsp, doMon, "rdrsp")
+
+  // written through the otherwise unused write channel of port 0
+  makeStatusBlockWriter("Perf", io.statusBlock, io.perf.flatten, 0)
 }
@@ -10,10 +10,13 @@ class TestMultiChanSum(p: PlatformWrapperParams) extends GenericAccelerator(p) {
   val numMemPorts = 1
   val numChans = 2
   val io = new GenericAcceleratorIF(numMemPorts, p) {
-    val start = Bool(INPUT)
+    // each channel is started and finishes independently
+    val start = Vec.fill(numChans) {Bool(INPUT)}
     val baseAddr = Vec.fill(numChans) {UInt(INPUT, width=64)}
     val byteCount = Vec.fill(numChans) {UInt(INPUT, width=32)}
     val sum = Vec.fill(numChans) {UInt(OUTPUT, width=32)}
+    val finished = Vec.fill(numChans) {Bool(OUTPUT)}
+    val cycleCount = Vec.fill(numChans) {UInt(OUTPUT, width=32)}
     val status = Bool(OUTPUT)
   }
   plugMemWritePort(0) // write ports not used
@@ -38,7 +41,7 @@ class TestMultiChanSum(p: PlatformWrapperParams) extends GenericAccelerator(p) {
   // regGen -> intl -> (memRdReq) -> (memRdRsp) -> deintl -> reducer
 
   for(i <- 0 until numChans) {
-    readers(i).start := io.start
+    readers(i).start := io.start(i)
     readers(i).baseAddr := io.baseAddr(i)
     readers(i).byteCount := io.byteCount(i)
 
@@ -46,9 +49,15 @@ class TestMultiChanSum(p: PlatformWrapperParams) extends GenericAccelerator(p) {
     deintl.rspOut(i) <> readers(i).rsp
     readers(i).out <> reducers(i).streamIn
 
-    reducers(i).start := io.start
+    reducers(i).start := io.start(i)
     reducers(i).byteCount := io.byteCount(i)
     io.sum(i) := reducers(i).reduced
+    io.finished(i) := reducers(i).finished
+
+    val regCycleCount = Reg(init = UInt(0, 32))
+    io.cycleCount(i) := regCycleCount
+    when(!io.start(i)) {regCycleCount := UInt(0)}
+    .elsewhen(!reducers(i).finished) {regCycleCount := regCycleCount + UInt(1)}
   }
 
   intl.reqOut <> io.memPort(0).memRdReq
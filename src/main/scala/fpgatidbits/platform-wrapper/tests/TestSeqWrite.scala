@@ -14,6 +14,7 @@ class TestSeqWrite(p: PlatformWrapperParams) extends GenericAccelerator(p) {
     val init = UInt(INPUT, width = 32)
     val step = UInt(INPUT, width = 32)
     val count = UInt(INPUT, width = 32)
+    val cycleCount = UInt(OUTPUT, width = 32)
   }
   plugMemReadPort(0)  // read port not used
   io.signature := makeDefaultSignature()
@@ -37,4 +38,9 @@ class TestSeqWrite(p: PlatformWrapperParams) extends GenericAccelerator(p) {
   sw.req <> io.memPort(0).memWrReq
   sw.wdat <> io.memPort(0).memWrDat
   io.memPort(0).memWrRsp <> sw.rsp
+
+  val regCycleCount = Reg(init = UInt(0, 32))
+  io.cycleCount := regCycleCount
+  when(!io.start) {regCycleCount := UInt(0)}
+  .elsewhen(io.start & !io.finished) {regCycleCount := regCycleCount + UInt(1)}
 }
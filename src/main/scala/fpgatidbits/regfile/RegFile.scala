@@ -33,7 +33,12 @@ class RegFileSlaveIF(idBits: Int, dataBits: Int) extends Bundle {
 }
 
 
-class RegFile(numRegs: Int, idBits: Int, dataBits: Int) extends Module {
+// snapshotGroups lists the registers of values that span several registers
+// (lowest register first). reading the first register of a group latches the
+// rest of the group, and reads of those return the latched words, so a wide
+// value that is read lowest register first does not tear while it changes.
+class RegFile(numRegs: Int, idBits: Int, dataBits: Int,
+  snapshotGroups: Seq[Seq[Int]] = Seq()) extends Module {
   val io = new Bundle {
     // external command interface
     val extIF = new RegFileSlaveIF(idBits, dataBits)
@@ -56,11 +61,23 @@ class RegFile(numRegs: Int, idBits: Int, dataBits: Int) extends Module {
   val hasExtReadCommand = (regDoCmd && regCommand.read)
   val hasExtWriteCommand = (regDoCmd && regCommand.write)
 
+  // snapshot registers for the upper words of the snapshot groups
+  val snapshots = scala.collection.mutable.Map[Int, UInt]()
+  for(g <- snapshotGroups) {
+    val doSnapshot = hasExtReadCommand && (regCommand.regID === UInt(g(0)))
+    for(r <- g.drop(1)) {
+      val snapshot = Reg(init = UInt(0, width = dataBits))
+      when(doSnapshot) { snapshot := regFile(r) }
+      snapshots(r) = snapshot
+    }
+  }
+  val readView = Vec.tabulate(numRegs) { i => snapshots.getOrElse(i, regFile(i)) }
+
   // register read logic
   io.extIF.readData.valid := hasExtReadCommand
   // make sure regID stays within range for memory read
   when (regCommand.regID < UInt(numRegs)) {
-    io.extIF.readData.bits  := regFile(regCommand.regID)
+    io.extIF.readData.bits  := readView(regCommand.regID)
   } .otherwise {
     // return 0 otherwise
     io.extIF.readData.bits  := UInt(0)
@@ -3,13 +3,44 @@
 # requires a recent version of verilator, e.g. 3.878
 VERILATOR_SRC_DIR="/usr/local/share/verilator/include"
 
+# trace support compiled into the model: vcd (default), fst (compressed,
+# needs Verilator 4.x and zlib) or none (fastest model, can't use -DTRACE)
+TRACE_FORMAT=${TRACE_FORMAT:-vcd}
+case $TRACE_FORMAT in
+  fst) TRACE_FLAG="--trace-fst" ;;
+  none) TRACE_FLAG="" ;;
+  *) TRACE_FLAG="--trace" ;;
+esac
+
+# set SAVABLE=1 to enable checkpoint save/restore of the model
+SAVE_FLAG=""
+SAVE_OPTS=""
+if [ -n "$SAVABLE" ]; then
+  SAVE_FLAG="--savable"
+  SAVE_OPTS="-DSAVABLE"
+fi
+
 # call verilator to translate verilog to C++
-verilator -Iother-verilog --cc TesterWrapper.v -Wno-assignin -Wno-fatal -Wno-lint -Wno-style -Wno-COMBDLY -Wno-STMTDLY --Mdir verilated --trace
+verilator -Iother-verilog --cc TesterWrapper.v -Wno-assignin -Wno-fatal -Wno-lint -Wno-style -Wno-COMBDLY -Wno-STMTDLY --Mdir verilated $TRACE_FLAG $SAVE_FLAG
 # if verilator freezes while executing, consider adding +define+SYNTHESIS=1
 # to the cmdline here. this will disable the Chisel printfs though.
 
 # add verilated.cpp from source dirs
 cp -f $VERILATOR_SRC_DIR/verilated.cpp .
 cp -f $VERILATOR_SRC_DIR/verilated_vcd_c.cpp .
+if [ -n "$SAVABLE" ]; then
+  cp -f $VERILATOR_SRC_DIR/verilated_save.cpp .
+fi
+TRACE_OPTS=""
+if [ "$TRACE_FORMAT" = "fst" ]; then
+  # FST writer and its compression libraries are plain C
+  cp -f $VERILATOR_SRC_DIR/verilated_fst_c.cpp .
+  for f in fstapi lz4 fastlz; do
+    gcc -O2 -c -I$VERILATOR_SRC_DIR/gtkwave $VERILATOR_SRC_DIR/gtkwave/$f.c -o $f.o
+  done
+  TRACE_OPTS="fstapi.o lz4.o fastlz.o -lz -DTRACE_FST"
+fi
 # compile everything
-g++ -std=c++11 $@ -I$VERILATOR_SRC_DIR -Iverilated *.cpp verilated/*.cpp -o VerilatedTesterWrapper
+# pass -DTRACE to enable waveform dumping, then arm it at runtime (see
+# verilatedtesterdriver.hpp) or set TRACE_START/TRACE_CYCLES in the environment
+g++ -std=c++11 $@ -I$VERILATOR_SRC_DIR -Iverilated *.cpp verilated/*.cpp $TRACE_OPTS $SAVE_OPTS -o VerilatedTesterWrapper